@@ -0,0 +1,37 @@
+# the views of the application, for the benchmarks of a GraphWidget.
+# mindmapmodel comes with bench.pri
+QT += widgets concurrent
+
+HEADERS += $$PWD/../include/binarymap.h \
+    $$PWD/../include/clusterlayer.h \
+    $$PWD/../include/dragghost.h \
+    $$PWD/../include/edge.h \
+    $$PWD/../include/edgelayer.h \
+    $$PWD/../include/forcelayout.h \
+    $$PWD/../include/graphwidget.h \
+    $$PWD/../include/itempool.h \
+    $$PWD/../include/journal.h \
+    $$PWD/../include/mainwindow.h \
+    $$PWD/../include/mindmapfile.h \
+    $$PWD/../include/node.h \
+    $$PWD/../include/rendercache.h \
+    $$PWD/../include/spatialgrid.h \
+    $$PWD/../include/treelayout.h
+
+SOURCES += $$PWD/../src/clusterlayer.cpp \
+    $$PWD/../src/dragghost.cpp \
+    $$PWD/../src/edge.cpp \
+    $$PWD/../src/edgelayer.cpp \
+    $$PWD/../src/forcelayout.cpp \
+    $$PWD/../src/graphwidget.cpp \
+    $$PWD/../src/journal.cpp \
+    $$PWD/../src/mainwindow.cpp \
+    $$PWD/../src/mindmapfile.cpp \
+    $$PWD/../src/node.cpp \
+    $$PWD/../src/rendercache.cpp \
+    $$PWD/../src/spatialgrid.cpp \
+    $$PWD/../src/treelayout.cpp
+
+FORMS += $$PWD/../ui/mainwindow.ui
+
+RESOURCES += $$PWD/../images/qtmindmap.qrc
@@ -0,0 +1,13 @@
+# shared by the benchmarks: QtTest and the synthetic maps
+
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/..
+
+HEADERS += $$PWD/syntheticmap.h \
+    $$PWD/../include/mindmapmodel.h
+
+SOURCES += $$PWD/syntheticmap.cpp \
+    $$PWD/../src/mindmapmodel.cpp
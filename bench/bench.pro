@@ -0,0 +1,12 @@
+# benchmarks on synthetic maps, one QtTest program each.
+# Run them from a release build, without a display:
+#   QT_QPA_PLATFORM=offscreen ./spatialgrid/spatialgridbench
+#   QT_QPA_PLATFORM=offscreen ./view/viewbench
+#   ./forcelayout/forcelayoutbench
+#   QT_QPA_PLATFORM=offscreen ./itempool/itempoolbench
+TEMPLATE = subdirs
+
+SUBDIRS += spatialgrid \
+    view \
+    forcelayout \
+    itempool
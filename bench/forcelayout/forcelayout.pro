@@ -0,0 +1,10 @@
+# user-021: the force layout on 1, 2, 4... cores
+TARGET = forcelayoutbench
+include(../bench.pri)
+
+QT += concurrent
+
+HEADERS += ../../include/forcelayout.h
+
+SOURCES += forcelayoutbench.cpp \
+    ../../src/forcelayout.cpp
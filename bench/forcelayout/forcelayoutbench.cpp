@@ -0,0 +1,73 @@
+#include <QtTest>
+#include <QThreadPool>
+
+#include "include/forcelayout.h"
+#include "bench/syntheticmap.h"
+
+// the force layout of a map until it cools down, with the threads of the
+// global pool limited: the iterations and the parallel parts of them run
+// there
+class ForceLayoutBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void layout_data();
+    void layout();
+    void cleanup();
+};
+
+void ForceLayoutBench::layout_data()
+{
+    QTest::addColumn<int>( "nodes" );
+    QTest::addColumn<int>( "threads" );
+
+    const int sizes[] = { 5000, 20000 };
+    QList<int> threads;
+    threads << 1 << 2 << 4;
+
+    if ( QThread::idealThreadCount() > 4 )
+        threads << QThread::idealThreadCount();
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        foreach ( int count, threads )
+        {
+            const QByteArray name = QByteArray::number( sizes[i] ) + " nodes " +
+                                    QByteArray::number( count ) + " threads";
+            QTest::newRow( name.constData() ) << sizes[i] << count;
+        }
+    }
+}
+
+// a map with 10% of secondary edges, the weak springs
+void ForceLayoutBench::layout()
+{
+    QFETCH( int, nodes );
+    QFETCH( int, threads );
+
+    const MindMapModel model = syntheticMap( nodes, nodes / 10 );
+    QThreadPool::globalInstance()->setMaxThreadCount( threads );
+    ForceLayout layout;
+    QVector<QPointF> positions;
+
+    QBENCHMARK_ONCE
+    {
+        layout.start( model );
+
+        while ( layout.isRunning() )
+            QThread::msleep( 1 );
+    }
+
+    QVERIFY( layout.takePositions( positions ) );
+    QCOMPARE( positions.size(), nodes );
+}
+
+void ForceLayoutBench::cleanup()
+{
+    QThreadPool::globalInstance()->setMaxThreadCount( QThread::idealThreadCount() );
+}
+
+QTEST_MAIN( ForceLayoutBench )
+#include "forcelayoutbench.moc"
@@ -0,0 +1,6 @@
+# user-009: ItemPool against the heap, loading and closing a big map
+TARGET = itempoolbench
+include(../bench.pri)
+include(../app.pri)
+
+SOURCES += itempoolbench.cpp
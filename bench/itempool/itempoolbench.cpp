@@ -0,0 +1,156 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "include/mainwindow.h"
+#include "include/graphwidget.h"
+#include "include/mindmapfile.h"
+#include "include/itempool.h"
+#include "include/node.h"
+#include "include/edge.h"
+#include "bench/syntheticmap.h"
+
+// the blocks of the views: ItemPool against operator new, in the pattern
+// of a map (all allocated, then all freed) and of editing (one allocated
+// and freed at a time). And the views of a 50000 node map created and
+// released by GraphWidget, the pooled blocks and chunks reported
+class ItemPoolBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase();
+    void blocks_data();
+    void blocks();
+    void load();
+    void close();
+
+private:
+
+    QString m_fileName;
+    QTemporaryDir m_dir;
+};
+
+// not constructed, only the storage matters
+union NodeBlock
+{
+    char bytes[sizeof( Node )];
+    void *align;
+};
+
+union EdgeBlock
+{
+    char bytes[sizeof( Edge )];
+    void *align;
+};
+
+static const int blockCount = 20000;
+static const int mapNodes = 50000;
+
+template <typename T>
+static void allocateMap( QVector<void *> &blocks, const bool &pooled )
+{
+    for ( int i = 0; i < blocks.size(); i++ )
+        blocks[i] = pooled ? ItemPool<T>::allocate() : ::operator new( sizeof( T ) );
+
+    for ( int i = blocks.size() - 1; i >= 0; i-- )
+    {
+        if ( pooled )
+            ItemPool<T>::deallocate( blocks.at( i ) );
+        else
+            ::operator delete( blocks.at( i ) );
+    }
+
+    if ( pooled )
+        ItemPool<T>::clear();
+}
+
+template <typename T>
+static void allocateOne( const int &count, const bool &pooled )
+{
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( pooled )
+            ItemPool<T>::deallocate( ItemPool<T>::allocate() );
+        else
+            ::operator delete( ::operator new( sizeof( T ) ) );
+    }
+}
+
+void ItemPoolBench::initTestCase()
+{
+    QVERIFY( m_dir.isValid() );
+    m_fileName = m_dir.path() + "/map.qmmb";
+    QVERIFY( MindMapFile::write( syntheticMap( mapNodes, mapNodes / 20 ), m_fileName ) );
+}
+
+void ItemPoolBench::blocks_data()
+{
+    QTest::addColumn<bool>( "edges" );
+    QTest::addColumn<bool>( "map" );
+    QTest::addColumn<bool>( "pooled" );
+
+    QTest::newRow( "Node map pool" ) << false << true << true;
+    QTest::newRow( "Node map heap" ) << false << true << false;
+    QTest::newRow( "Node edit pool" ) << false << false << true;
+    QTest::newRow( "Node edit heap" ) << false << false << false;
+    QTest::newRow( "Edge map pool" ) << true << true << true;
+    QTest::newRow( "Edge map heap" ) << true << true << false;
+    QTest::newRow( "Edge edit pool" ) << true << false << true;
+    QTest::newRow( "Edge edit heap" ) << true << false << false;
+}
+
+void ItemPoolBench::blocks()
+{
+    QFETCH( bool, edges );
+    QFETCH( bool, map );
+    QFETCH( bool, pooled );
+
+    QVector<void *> blocks( blockCount );
+
+    QBENCHMARK
+    {
+        if ( map && edges )
+            allocateMap<EdgeBlock>( blocks, pooled );
+        else if ( map )
+            allocateMap<NodeBlock>( blocks, pooled );
+        else if ( edges )
+            allocateOne<EdgeBlock>( blockCount, pooled );
+        else
+            allocateOne<NodeBlock>( blockCount, pooled );
+    }
+}
+
+// reading included, as opening a map in the application
+void ItemPoolBench::load()
+{
+    MainWindow window;
+    GraphWidget view( &window );
+
+    QBENCHMARK_ONCE
+    {
+        QVERIFY( view.readContentFromFile( m_fileName ) );
+    }
+
+    qDebug() << ItemPool<Node>::used() << "Nodes in" << ItemPool<Node>::chunks() << "chunks,"
+             << ItemPool<Edge>::used() << "Edges in" << ItemPool<Edge>::chunks() << "chunks";
+    view.closeScene();
+}
+
+void ItemPoolBench::close()
+{
+    MainWindow window;
+    GraphWidget view( &window );
+    QVERIFY( view.readContentFromFile( m_fileName ) );
+
+    QBENCHMARK_ONCE
+    {
+        view.closeScene();
+    }
+
+    QCOMPARE( ItemPool<Node>::chunks(), 0 );
+    QCOMPARE( ItemPool<Edge>::chunks(), 0 );
+}
+
+QTEST_MAIN( ItemPoolBench )
+#include "itempoolbench.moc"
@@ -0,0 +1,10 @@
+# user-013: SpatialGrid against the NoIndex and BspTreeIndex of the scene
+TARGET = spatialgridbench
+include(../bench.pri)
+
+QT += widgets
+
+HEADERS += ../../include/spatialgrid.h
+
+SOURCES += spatialgridbench.cpp \
+    ../../src/spatialgrid.cpp
@@ -0,0 +1,202 @@
+#include <QtTest>
+#include <QGraphicsScene>
+#include <QGraphicsLineItem>
+#include <QGraphicsRectItem>
+
+#include "include/spatialgrid.h"
+#include "bench/syntheticmap.h"
+
+// SpatialGrid (two of them, as GraphWidget keeps one for the Nodes and
+// one for the Edges) against the indexes of QGraphicsScene on the same
+// rects and lines: moving everything (a force layout frame) and the
+// queries of a view panned over the map
+class SpatialGridBench : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    enum Index
+    {
+        Grid,
+        NoIndex,
+        BspTreeIndex
+    };
+
+private slots:
+
+    void update_data();
+    void update();
+    void query_data();
+    void query();
+
+private:
+
+    void addRows();
+    void build(const int &nodes, const int &index);
+
+    MindMapModel m_model;
+    QVector<QRectF> m_nodeRects;
+    QVector<QLineF> m_lines;
+    SpatialGrid m_nodeGrid;
+    SpatialGrid m_edgeGrid;
+    QGraphicsScene *m_scene;
+    QVector<QGraphicsRectItem *> m_nodeItems;
+    QVector<QGraphicsLineItem *> m_edgeItems;
+};
+
+// as Edge: pen and arrow head
+static const qreal margin = 10;
+
+void SpatialGridBench::addRows()
+{
+    QTest::addColumn<int>( "nodes" );
+    QTest::addColumn<int>( "index" );
+
+    const int sizes[] = { 1000, 20000 };
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        const QByteArray size = QByteArray::number( sizes[i] );
+        QTest::newRow( ( size + " SpatialGrid" ).constData() ) << sizes[i] << int( Grid );
+        QTest::newRow( ( size + " NoIndex" ).constData() ) << sizes[i] << int( NoIndex );
+        QTest::newRow( ( size + " BspTreeIndex" ).constData() ) << sizes[i] << int( BspTreeIndex );
+    }
+}
+
+// a map with 5% of long secondary edges
+void SpatialGridBench::build( const int& nodes, const int& index )
+{
+    m_model = syntheticMap( nodes, nodes / 20 );
+    m_nodeRects.resize( m_model.nodeCount() );
+    m_lines.resize( m_model.edgeCount() );
+
+    for ( int i = 0; i < m_model.nodeCount(); i++ )
+        m_nodeRects[i] = QRectF( m_model.pos( i ), m_model.size( i ) );
+
+    for ( int i = 0; i < m_model.edgeCount(); i++ )
+        m_lines[i] = QLineF( m_nodeRects.at( m_model.source( i ) ).center(),
+                             m_nodeRects.at( m_model.destination( i ) ).center() );
+
+    m_nodeGrid.clear();
+    m_edgeGrid.clear();
+    m_scene = 0;
+    m_nodeItems.clear();
+    m_edgeItems.clear();
+
+    if ( index == Grid )
+    {
+        for ( int i = 0; i < m_nodeRects.size(); i++ )
+            m_nodeGrid.update( i, m_nodeRects.at( i ) );
+
+        for ( int i = 0; i < m_lines.size(); i++ )
+            m_edgeGrid.update( i, m_lines.at( i ), margin );
+
+        return;
+    }
+
+    m_scene = new QGraphicsScene( this );
+    m_scene->setItemIndexMethod( index == NoIndex ?
+                                 QGraphicsScene::NoIndex :
+                                 QGraphicsScene::BspTreeIndex );
+
+    for ( int i = 0; i < m_nodeRects.size(); i++ )
+        m_nodeItems.append( m_scene->addRect( m_nodeRects.at( i ) ) );
+
+    for ( int i = 0; i < m_lines.size(); i++ )
+        m_edgeItems.append( m_scene->addLine( m_lines.at( i ), QPen( Qt::black, 2 * margin ) ) );
+
+    // the BSP tree is built lazily, not in the first iteration
+    m_scene->items( QRectF( 0, 0, 1, 1 ) );
+}
+
+void SpatialGridBench::update_data()
+{
+    addRows();
+}
+
+// every Node and Edge moves a little, back and forth
+void SpatialGridBench::update()
+{
+    QFETCH( int, nodes );
+    QFETCH( int, index );
+    build( nodes, index );
+    qreal offset = 3;
+
+    QBENCHMARK
+    {
+        offset = -offset;
+        const QPointF move( offset, offset );
+
+        if ( index == Grid )
+        {
+            for ( int i = 0; i < m_nodeRects.size(); i++ )
+            {
+                m_nodeRects[i].translate( move );
+                m_nodeGrid.update( i, m_nodeRects.at( i ) );
+            }
+
+            for ( int i = 0; i < m_lines.size(); i++ )
+            {
+                m_lines[i].translate( move );
+                m_edgeGrid.update( i, m_lines.at( i ), margin );
+            }
+        }
+        else
+        {
+            for ( int i = 0; i < m_nodeItems.size(); i++ )
+                m_nodeItems.at( i )->moveBy( offset, offset );
+
+            for ( int i = 0; i < m_edgeItems.size(); i++ )
+            {
+                m_lines[i].translate( move );
+                m_edgeItems.at( i )->setLine( m_lines.at( i ) );
+            }
+
+            // the index catches up before the next query
+            m_scene->items( QRectF( 0, 0, 1, 1 ) );
+        }
+    }
+
+    delete m_scene;
+}
+
+void SpatialGridBench::query_data()
+{
+    addRows();
+}
+
+// a 1280x800 view at zoom 1, at 100 places along the diagonal of the map
+void SpatialGridBench::query()
+{
+    QFETCH( int, nodes );
+    QFETCH( int, index );
+    build( nodes, index );
+    QRectF bounds;
+
+    foreach ( const QRectF& rect, m_nodeRects )
+        bounds = bounds.united( rect );
+
+    int found = 0;
+
+    QBENCHMARK
+    {
+        for ( int i = 0; i < 100; i++ )
+        {
+            const QRectF view( bounds.topLeft() + QPointF( bounds.width() * i / 100,
+                               bounds.height() * i / 100 ), QSizeF( 1280, 800 ) );
+
+            // as the scene is drawn: by bounding rects
+            if ( index == Grid )
+                found += m_nodeGrid.query( view ).size() + m_edgeGrid.query( view ).size();
+            else
+                found += m_scene->items( view, Qt::IntersectsItemBoundingRect ).size();
+        }
+    }
+
+    QVERIFY( found > 0 );
+    delete m_scene;
+}
+
+QTEST_MAIN( SpatialGridBench )
+#include "spatialgridbench.moc"
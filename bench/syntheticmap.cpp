@@ -0,0 +1,60 @@
+#include "syntheticmap.h"
+
+#include <qmath.h>
+
+#include <cmath>
+
+// not qrand: the same maps on every platform
+static quint32 next( quint32& state )
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static int below( quint32& state, const int& n )
+{
+    return int( next( state ) % quint32( n ) );
+}
+
+MindMapModel syntheticMap( const int& nodes, const int& crossLinks, const int& branch )
+{
+    MindMapModel model;
+    quint32 state = 12345;
+    model.beginBulkUpdate();
+
+    for ( int i = 0; i < nodes; i++ )
+    {
+        const int node = model.addNode();
+        model.setContent( node, QString( "<p>node %1</p>" ).arg( node ).toUtf8() );
+        model.setSize( node, QSizeF( 60 + below( state, 60 ), 24 ) );
+
+        if ( node == 0 )
+            continue;
+
+        // parents of the branch are in the branch, the others outside it
+        int parent;
+
+        if ( node <= branch )
+            parent = node == 1 ? 0 : 1 + below( state, node - 1 );
+        else
+            parent = node == branch + 1 ? 0 : branch + 1 + below( state, node - branch - 1 );
+
+        const qreal angle = below( state, 3600 ) * M_PI / 1800;
+        const qreal distance = 150 + below( state, 150 );
+        model.setPos( node, model.pos( parent ) +
+                      QPointF( std::cos( angle ) * distance, std::sin( angle ) * distance ) );
+        model.addEdge( parent, node );
+    }
+
+    for ( int i = 0; i < crossLinks && nodes > 1; i++ )
+    {
+        const int source = below( state, nodes );
+        const int destination = below( state, nodes );
+
+        if ( source != destination && model.edgeBetween( source, destination ) == -1 )
+            model.setSecondary( model.addEdge( source, destination ), true );
+    }
+
+    model.endBulkUpdate();
+    return model;
+}
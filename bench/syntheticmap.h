@@ -0,0 +1,13 @@
+#ifndef SYNTHETICMAP_H
+#define SYNTHETICMAP_H
+
+#include "include/mindmapmodel.h"
+
+// Maps of any size for the benchmarks, the same for the same arguments.
+// A random tree: every node is placed around its parent, the first branch
+// nodes (after the root) form the subtree of node 1. crossLinks secondary
+// edges join random nodes, far from each other mostly
+MindMapModel syntheticMap(const int &nodes, const int &crossLinks = 0,
+                          const int &branch = 0);
+
+#endif // SYNTHETICMAP_H
@@ -0,0 +1,7 @@
+# user-012: frame time with batched edges and with an item per Edge
+# user-024: frame time while a subtree is dragged
+TARGET = viewbench
+include(../bench.pri)
+include(../app.pri)
+
+SOURCES += viewbench.cpp
@@ -0,0 +1,167 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QGraphicsSceneMouseEvent>
+
+#include "include/mainwindow.h"
+#include "include/graphwidget.h"
+#include "include/mindmapfile.h"
+#include "include/node.h"
+#include "bench/syntheticmap.h"
+
+// frames of a GraphWidget on a loaded map, as the user sees them: the
+// whole viewport rendered, at zoom 1 and with the whole map fit in, and
+// while a subtree is dragged
+class ViewBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase();
+    void frame_data();
+    void frame();
+    void drag_data();
+    void drag();
+
+private:
+
+    QString mapFile(const int &nodes, const int &branch = 0) const;
+
+    QTemporaryDir m_dir;
+};
+
+static const int sizes[] = { 2000, 20000 };
+static const int dragNodes = 20000;
+static const int branches[] = { 400, 5000 };
+
+QString ViewBench::mapFile( const int& nodes, const int& branch ) const
+{
+    return m_dir.path() + "/map" + QString::number( nodes ) + "-" +
+           QString::number( branch ) + ".qmmb";
+}
+
+// a view of its own, on top of the one of the window
+static void showView( MainWindow& window, GraphWidget& view )
+{
+    window.resize( 1280, 800 );
+    view.setGeometry( 0, 0, 1280, 800 );
+    window.show();
+}
+
+// the maps are read as the application reads them, from files
+void ViewBench::initTestCase()
+{
+    QVERIFY( m_dir.isValid() );
+
+    // a map with 5% of long secondary edges
+    for ( int i = 0; i < 2; i++ )
+        QVERIFY( MindMapFile::write( syntheticMap( sizes[i], sizes[i] / 20 ),
+                                     mapFile( sizes[i] ) ) );
+
+    // the same, node 1 with a subtree of the size to drag
+    for ( int i = 0; i < 2; i++ )
+        QVERIFY( MindMapFile::write( syntheticMap( dragNodes, dragNodes / 20, branches[i] ),
+                                     mapFile( dragNodes, branches[i] ) ) );
+}
+
+void ViewBench::frame_data()
+{
+    QTest::addColumn<int>( "nodes" );
+    QTest::addColumn<bool>( "batched" );
+    QTest::addColumn<bool>( "fit" );
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        const QByteArray size = QByteArray::number( sizes[i] );
+        QTest::newRow( ( size + " batched zoom 1" ).constData() ) << sizes[i] << true << false;
+        QTest::newRow( ( size + " items zoom 1" ).constData() ) << sizes[i] << false << false;
+        QTest::newRow( ( size + " batched fit" ).constData() ) << sizes[i] << true << true;
+        QTest::newRow( ( size + " items fit" ).constData() ) << sizes[i] << false << true;
+    }
+}
+
+void ViewBench::frame()
+{
+    QFETCH( int, nodes );
+    QFETCH( bool, batched );
+    QFETCH( bool, fit );
+
+    MainWindow window;
+    GraphWidget view( &window );
+    showView( window, view );
+    QVERIFY( QTest::qWaitForWindowExposed( &window ) );
+    QVERIFY( view.readContentFromFile( mapFile( nodes ) ) );
+    view.setBatchedEdges( batched );
+
+    // the edges are measured, not the cluster glyphs of a far zoom
+    if ( fit )
+        view.fitInView( view.scene()->itemsBoundingRect(), Qt::KeepAspectRatio );
+    else
+        view.centerOn( view.node( 0 ) );
+
+    view.setClustered( false );
+    QImage image( view.viewport()->size(), QImage::Format_ARGB32_Premultiplied );
+
+    QBENCHMARK
+    {
+        QPainter painter( &image );
+        view.render( &painter );
+    }
+}
+
+void ViewBench::drag_data()
+{
+    QTest::addColumn<int>( "branch" );
+    QTest::addColumn<bool>( "subtree" );
+
+    // the Nodes of a smaller subtree are moved in a group, a bigger one
+    // is dragged as a ghost
+    QTest::newRow( "node" ) << branches[1] << false;
+    QTest::newRow( "400 nodes subtree" ) << branches[0] << true;
+    QTest::newRow( "5000 nodes subtree" ) << branches[1] << true;
+}
+
+// a mouse move and the frame after it, the subtree of node 1 dragged
+// back and forth on the map with batched edges
+void ViewBench::drag()
+{
+    QFETCH( int, branch );
+    QFETCH( bool, subtree );
+
+    MainWindow window;
+    GraphWidget view( &window );
+    showView( window, view );
+    QVERIFY( QTest::qWaitForWindowExposed( &window ) );
+    QVERIFY( view.readContentFromFile( mapFile( dragNodes, branch ) ) );
+    QCOMPARE( view.model().subtreeSize( 1 ), branch );
+
+    Node* node = view.node( 1 );
+    view.centerOn( node );
+    view.nodeSelected( node );
+    QImage image( view.viewport()->size(), QImage::Format_ARGB32_Premultiplied );
+
+    QGraphicsSceneMouseEvent event( QEvent::GraphicsSceneMouseMove );
+    event.setModifiers( subtree ? Qt::ControlModifier | Qt::ShiftModifier : Qt::NoModifier );
+    event.setScenePos( node->pos() );
+    qreal step = 2;
+
+    // the first move starts the drag: the ghost is rendered, the group is made
+    event.setLastScenePos( event.scenePos() );
+    event.setScenePos( event.scenePos() + QPointF( step, step ) );
+    view.nodeMoved( &event );
+
+    QBENCHMARK
+    {
+        step = -step;
+        event.setLastScenePos( event.scenePos() );
+        event.setScenePos( event.scenePos() + QPointF( step, step ) );
+        view.nodeMoved( &event );
+        QPainter painter( &image );
+        view.render( &painter );
+    }
+
+    view.nodeReleased();
+}
+
+QTEST_MAIN( ViewBench )
+#include "viewbench.moc"
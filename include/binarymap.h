@@ -0,0 +1,99 @@
+#ifndef BINARYMAP_H
+#define BINARYMAP_H
+
+#include <QtGlobal>
+
+#include <string.h> // memcmp
+
+// On-disk layout of the binary map format (.qmmb).
+// The file is mapped into memory and read in place, so every section is
+// a fixed-width, 8-byte aligned table:
+//
+//   Header | NodeRecord[nodeCount] | EdgeRecord[edgeCount] | string heap
+//
+// Node content is stored as UTF-8 html in the string heap, it is decoded
+// only when the Node is shown for the first time.
+namespace BinaryMap
+{
+
+static const char magic[4] = { 'Q', 'M', 'M', 'B' };
+static const quint32 version = 1;
+// written in host order, a file from a host with other endianness fails
+static const quint32 byteOrderMark = 0x01020304;
+
+struct Header
+{
+    char magic[4];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 nodeCount;
+    quint32 edgeCount;
+    quint32 reserved;
+    quint64 nodeTableOffset;
+    quint64 edgeTableOffset;
+    quint64 stringHeapOffset;
+    quint64 stringHeapSize;
+};
+
+struct NodeRecord
+{
+    double x;
+    double y;
+    float scale;
+    // size of the content, so geometry is right before it is decoded
+    float width;
+    float height;
+    quint32 contentOffset;
+    quint32 contentLength;
+    quint8 bgRed;
+    quint8 bgGreen;
+    quint8 bgBlue;
+    quint8 textRed;
+    quint8 textGreen;
+    quint8 textBlue;
+    quint8 reserved[6];
+};
+
+struct EdgeRecord
+{
+    quint32 source;
+    quint32 destination;
+    float width;
+    quint8 red;
+    quint8 green;
+    quint8 blue;
+    quint8 secondary;
+};
+
+Q_STATIC_ASSERT( sizeof( Header ) == 56 );
+Q_STATIC_ASSERT( sizeof( NodeRecord ) == 48 );
+Q_STATIC_ASSERT( sizeof( EdgeRecord ) == 16 );
+
+// the tables and the heap have to lie inside the file
+inline bool isValid( const Header* header, const qint64& fileSize )
+{
+    if ( fileSize < qint64( sizeof( Header ) ) ||
+         memcmp( header->magic, magic, sizeof( magic ) ) != 0 ||
+         header->version != version ||
+         header->byteOrder != byteOrderMark )
+        return false;
+
+    // offsets are checked before anything is added to them: a crafted
+    // offset near 2^64 would wrap around and pass an end check
+    const quint64 size = fileSize;
+
+    return header->nodeTableOffset % 8 == 0 &&
+           header->edgeTableOffset % 8 == 0 &&
+           header->nodeTableOffset >= sizeof( Header ) &&
+           header->edgeTableOffset >= sizeof( Header ) &&
+           header->nodeTableOffset <= size &&
+           header->edgeTableOffset <= size &&
+           header->nodeCount <= ( size - header->nodeTableOffset ) / sizeof( NodeRecord ) &&
+           header->edgeCount <= ( size - header->edgeTableOffset ) / sizeof( EdgeRecord ) &&
+           header->stringHeapOffset <= size &&
+           header->stringHeapSize <= size - header->stringHeapOffset;
+}
+
+} // namespace BinaryMap
+
+#endif // BINARYMAP_H
@@ -0,0 +1,46 @@
+#ifndef CLUSTERLAYER_H
+#define CLUSTERLAYER_H
+
+#include <QGraphicsItem>
+#include <QVector>
+
+class GraphWidget;
+
+// far zoom view of the map: subtrees of the primary tree which would be
+// small on the screen are drawn as one glyph, their bounding rect in the
+// color of the subtree's root with the number of descendants.
+// Shown instead of the Nodes and Edges, so what is drawn depends on the
+// screen area, not on the size of the map
+class ClusterLayer : public QGraphicsItem
+{
+public:
+
+    ClusterLayer(GraphWidget *graph);
+
+    // Nodes moved or the tree changed: bounds are calculated at next paint
+    void invalidate();
+
+    // the whole scene, follows it as it grows
+    void setRect(const QRectF &rect);
+    QRectF boundingRect() const;
+
+protected:
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+
+    // bounds of every subtree, in one pass over the pre-order
+    void calculateBounds();
+
+    GraphWidget *m_graph;
+    QRectF m_rect;
+    // indexed by the IDs of the subtrees' roots
+    QVector<QRectF> m_bounds;
+    bool m_boundsValid;
+
+    // a subtree bigger than this on the screen is opened up, in pixels
+    static const qreal m_glyphSize;
+};
+
+#endif // CLUSTERLAYER_H
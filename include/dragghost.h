@@ -0,0 +1,52 @@
+#ifndef DRAGGHOST_H
+#define DRAGGHOST_H
+
+#include <QGraphicsItem>
+#include <QPixmap>
+#include <QPen>
+#include <QVector>
+
+class GraphWidget;
+
+// stand-in of a big subtree while it is dragged: the subtree rendered
+// once into a pixmap, moved with the mouse together with lines for the
+// edges leaving it. The Nodes stay in place until it is dropped, so a
+// mouse move repaints the pixmap, not the thousands of items
+class DragGhost : public QGraphicsItem
+{
+public:
+
+    // rendered in the resolution of zoom, if it is not too big
+    DragGhost(GraphWidget *graph, const int &root, const qreal &zoom);
+
+    void drag(const QPointF &offset);
+    // from the subtree, in the scene
+    QPointF offset() const;
+
+    QRectF boundingRect() const;
+
+protected:
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+
+    void render(const int &root, const qreal &zoom);
+
+    GraphWidget *m_graph;
+    // where the subtree is in the scene, the pixmap is drawn there moved
+    QRectF m_rect;
+    QPixmap m_pixmap;
+    // edges leaving the subtree: from the end outside, which stays in
+    // place, to the end inside
+    QVector<QLineF> m_boundary;
+    QVector<QPen> m_boundaryPens;
+    // half of the widest of them
+    qreal m_margin;
+
+    // longer side of the pixmap, in pixels
+    static const qreal m_maxPixmapSize;
+    static const qreal m_opacity;
+};
+
+#endif // DRAGGHOST_H
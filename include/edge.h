@@ -2,16 +2,25 @@
 #define EDGE_H
 
 #include <QGraphicsItem>
+#include <QPainterPath>
 
 class Node;
+class GraphWidget;
 
-// directed arrow
+// directed arrow, view of the edge with this ID in the GraphWidget's model
 class Edge : public QGraphicsItem
 {
 public:
 
-    Edge(Node *sourceNode, Node *destNode);
-    ~Edge();
+    Edge(GraphWidget *graph, Node *sourceNode, Node *destNode, const int &id);
+
+    // views come from an ItemPool, a map is released in a few chunks
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer);
+
+    // the model moves edges to keep IDs dense, GraphWidget follows it
+    int id() const;
+    void setId(const int &id);
 
     Node *sourceNode() const;
     Node *destNode() const;
@@ -25,29 +34,43 @@ public:
     bool secondary() const;
     void setSecondary(const bool &sec = true );
 
-    // re-calculates the source and endpoint.
+    // re-calculates the source and endpoint, angle and arrow.
     // called when the source/dest node changed (size,pos)
     void adjust();
+    // moved together with both of its nodes: nothing to calculate again
+    void translate(const QPointF &offset);
 
-protected:
+    // cached geometry, for drawing it batched in the EdgeLayer
+    QPointF sourcePoint() const;
+    QPointF destPoint() const;
+    qreal length() const;
+    bool overlap() const;
+    const QPainterPath &arrowHead() const;
+    static qreal arrowSize();
 
     QRectF boundingRect() const;
+
+protected:
+
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
 
 private:
 
+    // repaint: the item itself, or its area of the EdgeLayer
+    void redraw(const QRectF &rect);
+
+    GraphWidget *m_graph;
+    int m_id;
     Node *m_sourceNode;
     Node *m_destNode;
 
     QPointF m_sourcePoint;
     QPointF m_destPoint;
+    // cached by adjust(), paint() only draws
     double m_angle;
-    QColor m_color;
-    qreal m_width;
-
-    // just a logical connection between two nodes,
-    // does not counts at subtree calculation
-    bool m_secondary;
+    qreal m_length;
+    bool m_overlap;
+    QPainterPath m_arrowHead;
 
     static const qreal m_arrowSize;
     static const double m_pi;
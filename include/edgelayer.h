@@ -0,0 +1,45 @@
+#ifndef EDGELAYER_H
+#define EDGELAYER_H
+
+#include <QGraphicsItem>
+#include <QColor>
+
+class GraphWidget;
+
+// draws every Edge of the GraphWidget as one item. The Edges are not in the
+// scene then, they only keep their geometry and report changes here.
+// Lines are batched by color, width and dash style into drawLines calls
+class EdgeLayer : public QGraphicsItem
+{
+public:
+
+    EdgeLayer(GraphWidget *graph);
+
+    // repaint the area of an edge: before and after a change
+    void edgeChanged(const QRectF &rect);
+
+    // the whole scene, follows it as it grows
+    void setRect(const QRectF &rect);
+    QRectF boundingRect() const;
+
+protected:
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+private:
+
+    // pen of a batch of lines
+    struct LineStyle
+    {
+        QRgb color;
+        qreal width;
+        bool dashed;
+
+        bool operator<(const LineStyle &other) const;
+    };
+
+    GraphWidget *m_graph;
+    QRectF m_rect;
+};
+
+#endif // EDGELAYER_H
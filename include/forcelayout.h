@@ -0,0 +1,96 @@
+#ifndef FORCELAYOUT_H
+#define FORCELAYOUT_H
+
+#include <QVector>
+#include <QPointF>
+#include <QFuture>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "mindmapmodel.h"
+
+// Force directed layout of the whole map, secondary edges included, on a
+// worker thread. Edges are springs (secondary ones weaker), nodes repulse
+// each other through a Barnes-Hut quadtree, the base node stays in place.
+// The forces of an iteration are calculated by all cores, on positions
+// kept as plain arrays of floats. Iterates until the map cools down.
+//
+// Works on a snapshot: the map must not change structurally meanwhile
+class ForceLayout
+{
+public:
+
+    ForceLayout();
+    ~ForceLayout();
+
+    void start(const MindMapModel &model);
+    // waits for the iteration in progress
+    void stop();
+    bool isRunning() const;
+
+    // positions of the last iteration, as MindMapModel::pos.
+    // False if there was no iteration since the previous call
+    bool takePositions(QVector<QPointF> &positions);
+
+private:
+
+    // the nodes of a part of the map, the forces on them are calculated
+    // in parallel with the other parts
+    struct Range
+    {
+        ForceLayout *layout;
+        int begin;
+        int end;
+    };
+
+    void run();
+    void buildQuadTree();
+    void insert(const int &body);
+    static void calculateForces(Range &range);
+    void repulse(const int &body, float &fx, float &fy) const;
+    void pull(const int &body, float &fx, float &fy) const;
+    // moves the nodes by their forces, at most by the temperature
+    void move(const float &temperature);
+    void publish();
+
+    MindMapModel m_model;
+    QFuture<void> m_future;
+    QAtomicInt m_stop;
+
+    // bodies: centers, forces and half sizes of the nodes
+    QVector<float> m_x;
+    QVector<float> m_y;
+    QVector<float> m_fx;
+    QVector<float> m_fy;
+    QVector<float> m_halfWidth;
+    QVector<float> m_halfHeight;
+    QVector<float> m_radius;
+
+    // quadtree cells: square, mass and its center, first of the 4 children
+    // (-1 for a leaf) and the body of a leaf (-1 empty, -2 several)
+    QVector<float> m_cellX;
+    QVector<float> m_cellY;
+    QVector<float> m_cellHalf;
+    QVector<float> m_massX;
+    QVector<float> m_massY;
+    QVector<float> m_mass;
+    QVector<int> m_cellChild;
+    QVector<int> m_cellBody;
+
+    QMutex m_mutex;
+    QVector<QPointF> m_positions;
+    bool m_fresh;
+
+    static const float m_idealLength;
+    static const float m_primaryStiffness;
+    static const float m_secondaryStiffness;
+    static const float m_theta;
+    static const float m_softening;
+    static const float m_cooling;
+    static const float m_frozen;
+    static const int m_maxIterations;
+    static const int m_maxDepth;
+    static const int m_rangeSize;
+};
+
+#endif // FORCELAYOUT_H
@@ -5,10 +5,24 @@
 #include <QGraphicsScene>
 #include <QKeyEvent>
 #include <QGraphicsSceneMouseEvent>
+#include <QFile>
+#include <QTimer>
+#include <QSet>
+#include <QDataStream>
+#include <QFutureWatcher>
+
+#include "journal.h"
+#include "mindmapmodel.h"
+#include "spatialgrid.h"
+#include "treelayout.h"
+#include "forcelayout.h"
 
 #include "node.h"
 
 class MainWindow;
+class EdgeLayer;
+class ClusterLayer;
+class DragGhost;
 
 class GraphWidget : public QGraphicsView
 {
@@ -16,20 +30,70 @@ class GraphWidget : public QGraphicsView
 
 public:
     GraphWidget(MainWindow *parent = 0);
+    // workers write from a snapshot, but report to members
+    ~GraphWidget();
 
     // node reports back it's state change
     void nodeSelected(Node *node);
     void nodeMoved(QGraphicsSceneMouseEvent *event);
+    void nodeReleased();
+    // true while a subtree is moved: edges are adjusted after, in one pass
+    bool movingNodes() const;
+    // position, content... of the node changed
+    void nodeChanged(Node *node);
+    // only the position: a smaller record in the journal
+    void nodePositionChanged(Node *node);
 
     // notify MainWindow: a node/edge has changed
     void contentChanged(const bool &changed = true);
 
+    // content of the map, Nodes and Edges are views of it.
+    // Edited node content reaches it with syncModel()
+    MindMapModel &model();
+    void syncModel();
+    Node *node(const int &id) const;
+    Edge *edge(const int &id) const;
+
+    // spatial index of the views, Nodes and Edges report their geometry
+    void updateIndex(Node *node);
+    void updateIndex(Edge *edge);
+    // picking and collision queries through the index, in scene coordinates
+    QList<Node *> nodesIn(const QRectF &rect) const;
+    Node *nodeAt(const QPointF &pos) const;
+    QVector<int> edgesIn(const QRectF &rect) const;
+
+    // draw all the edges as one item, instead of an item per Edge.
+    // Switched on by loading a map with many edges
+    EdgeLayer *edgeLayer() const;
+    void setBatchedEdges(const bool &batched);
+    bool batchedEdges() const;
+
+    // far zoom: subtrees drawn as glyphs by the ClusterLayer instead of
+    // the Nodes and Edges. Switched by zooming
+    void setClustered(const bool &clustered);
+    // zoomed a moment ago: Nodes may show a near zoom level scaled
+    bool zooming() const;
+
     // commands from MainWindow
     void newScene();
     void closeScene();
-    bool readContentFromXmlFile(const QString &fileName);
-    void writeContentToXmlFile(const QString &fileName);
+    // format is selected by the extension
+    bool readContentFromFile(const QString &fileName);
+    // serialised and written on a worker thread, from a snapshot.
+    // format is selected by the extension
+    void writeContentToFile(const QString &fileName);
     void writeContentToPngFile(const QString &fileName);
+    // copy of the synced model, cheap: shares the arrays until one changes
+    MindMapModel snapshot();
+
+    // start journaling changes of the map file, replay the journal of the
+    // previous session first. Returns true if unsaved changes were recovered
+    bool openJournal(const QString &fileName, const bool &recover = true);
+    // save with a checkpoint in the journal, false if there is no journal
+    bool saveJournal(const QString &fileName);
+    // the result of the last write is reported, the map is saved if
+    // it succeeded
+    void waitForBackgroundWrite();
 
 public slots:
 
@@ -47,10 +111,31 @@ public slots:
     void removeEdge();
     void nodeLostFocus();
     void hintMode();
+    // tidy tree from the base node, kept while Nodes are added/removed
+    void treeLayout();
+    void radialLayout();
+    // springs and repulsion on a worker thread, started/stopped
+    void forceLayout();
 
     // bundled signals from statusIconsToolBar
     void insertPicture(const QString &picture);
 
+private slots:
+
+    // write the batch of changes to the journal
+    void flushJournal();
+    void compactionFinished();
+
+    // background writes of files/exports
+    void backgroundWriteFinished();
+    void showWriteProgress();
+
+    // Nodes are rendered again in the exact zoom level
+    void zoomSettled();
+
+    // the last positions of the force layout to the Nodes
+    void forceLayoutFrame();
+
 protected:
 
     // key dispathcer of the whole program: long and pedant
@@ -63,35 +148,153 @@ private:
     // zoom in/out of the view
     void scaleView(qreal scaleFactor);
 
+    // the canvas grows by tiles to hold every Node, starts small with a map
+    void resizeScene(const QRectF &rect);
+    void growScene(const QRectF &rect);
+
+    // move the node, or its whole subtree, then adjust their edges once
+    void moveNodes(const int &root, const bool &subtree, const QPointF &offset);
+    void adjustEdges(const int &root, const bool &subtree);
+    // end of a batch of moves: the Nodes report while m_movingNodes is set
+    // only to the journal, the change is notified once
+    void nodesMoved();
+
+    // dragging a subtree: its Nodes are moved as one item, only the edges
+    // leaving it are adjusted. A big one is dragged as a DragGhost image.
+    // Positions are written when it is dropped
+    void beginGroupDrag(Node *root);
+    void dragGroup(const QPointF &offset);
+    void endGroupDrag();
+
+    // auto layout: the whole map, or the subtree of a changed Node
+    void layoutMap(const TreeLayout::Style &style);
+    void relayout(Node *root);
+    void placeNodes(const int &root, const TreeLayout &layout);
+    void placeAllNodes(const QVector<QPointF> &positions);
+    // before any change of the map it works on
+    void stopForceLayout();
+
     // functions on the edges
     QList<Edge *> allEdges() const;
     void addEdge(Node *source, Node *destination);
     void removeEdge(Node* source, Node *destination);
+    // edge in the model and its view
+    Edge *createEdge(Node *source, Node *destination);
+    void deleteEdge(Edge *edge);
 
     // functions on nodes
     void addFirstNode();
     void removeAllNodes();
     void setActiveNode(Node *node);
+    // view of a node already in the model
+    Node *createNodeView(const int &id);
+    // removes the node, its edges and their views
+    void deleteNode(Node *node);
+    // views for the whole model
+    void buildScene();
+    // center for a new child of the active Node: not overlapping others,
+    // near to angle (radians)
+    QPointF freePlace(Node *node, const double &angle) const;
+
+    // journal: records of changes, base file rewritten from a snapshot
+    void journalNode(const Journal::RecordType &type, Node *node);
+    void journalEdge(const Journal::RecordType &type, Node *source,
+                     Node *destination, Edge *edge = 0);
+    void journalRecord(const QByteArray &record);
+    void replayJournal(QList<QByteArray> &records);
+    bool replayNode(QDataStream &in, const bool &added);
+    void compactJournal();
+    // the window is still painted meanwhile
+    void waitForCompaction();
+    void closeJournal();
+
+    // one background write at a time, a new one waits for the previous
+    void startBackgroundWrite(const QFuture<bool> &future, const QString &fileName,
+                              const QString &message, const bool &mapFile);
 
-    // hint mode's nodenumber handling functions
+    // hint mode's nodenumber handling functions: numbers of the same
+    // length for the Nodes in the viewport, a Node is selected when its
+    // number is typed. The numbers under a typed prefix are a range
     void showNodeNumbers();
-    void showingAllNodeNumbers(const bool &show = true);
-    void showingNodeNumbersBeginWithNumber(const int &prefix, const bool &show = true);
+    void hideNodeNumbers();
+    void assignNodeNumbers();
+    // only Nodes entering or leaving the range are repainted
+    void showNodeNumberRange(const int &begin, const int &end);
 
+    MindMapModel m_model;
+    // views, indexed by the IDs in the model
     QList<Node *> m_nodeList;
+    QList<Edge *> m_edgeList;
+    SpatialGrid m_nodeGrid;
+    SpatialGrid m_edgeGrid;
     MainWindow *m_parent;
     Node *m_activeNode;
     QGraphicsScene *m_scene;
     bool m_showingNodeNumbers;
     QString m_hintNumber;
     Node *m_hintNode;
+    // Nodes by their number, the shown range of them
+    QVector<Node *> m_hintNodes;
+    int m_hintDigits;
+    int m_hintBegin;
+    int m_hintEnd;
     bool m_editingNode;
     bool m_edgeAdding;
     bool m_edgeDeleting;
     bool m_contentChanged;
+    bool m_movingNodes;
+    QGraphicsItem *m_dragGroup;
+    DragGhost *m_dragGhost;
+    Node *m_dragRoot;
+    // edges inside the dragged subtree and the ones leaving it
+    QVector<int> m_dragInnerEdges;
+    QVector<int> m_dragOuterEdges;
+    TreeLayout::Style m_layoutStyle;
+    ForceLayout m_forceLayout;
+    QTimer *m_forceLayoutTimer;
+    EdgeLayer *m_edgeLayer;
+    bool m_batchedEdges;
+    ClusterLayer *m_clusterLayer;
+    bool m_clustered;
+    bool m_zooming;
+    QTimer *m_zoomTimer;
     QString m_fileName;
+    Journal m_journal;
+    // Nodes changed since the last batch was written, and the ones
+    // only moved
+    QSet<Node *> m_journalDirty;
+    QSet<Node *> m_journalMoved;
+    QTimer *m_journalTimer;
+    QFutureWatcher<bool> m_compaction;
+    QFutureWatcher<bool> m_writing;
+    QAtomicInt m_writeProgress;
+    QTimer *m_writeProgressTimer;
+    // file being written, empty if there is no background write
+    QString m_writeFileName;
+    QString m_writeMessage;
+    bool m_writingMapFile;
+    bool m_changedWhileWriting;
 
     static const QColor m_paper;
+    static const int m_journalFlushInterval;
+    static const qint64 m_journalCompactSize;
+    static const int m_edgeBatchThreshold;
+    static const QRectF m_initialSceneRect;
+    static const qreal m_sceneTile;
+    static const qreal m_exportMargin;
+    static const qreal m_clusterZoom;
+    // kilobytes
+    static const int m_renderCacheBudget;
+    static const int m_zoomSettleInterval;
+    // frame rate of the force layout
+    static const int m_forceLayoutInterval;
+    // placing a new Node: distance from its parent, space around it
+    // and the number of places tried
+    static const qreal m_insertDistance;
+    static const qreal m_insertGap;
+    static const int m_insertTries;
+    // subtrees of this many Nodes are dragged as an image
+    static const int m_ghostDragThreshold;
 };
 
 #endif // GRAPHWIDGET_H
@@ -0,0 +1,109 @@
+#ifndef ITEMPOOL_H
+#define ITEMPOOL_H
+
+#include <QtGlobal>
+
+#include <new>
+#include <type_traits>
+
+// storage for the views of a map: blocks of sizeof(T) carved from chunks.
+// Freed blocks are reused, the chunks are kept until clear(): adding and
+// removing a single view does not allocate. Closing a map gives back its
+// memory in a few calls.
+// Not thread safe, views live on the GUI thread
+template <typename T>
+class ItemPool
+{
+public:
+
+    static void *allocate()
+    {
+        if ( !m_free )
+            grow();
+
+        Block *block = m_free;
+        m_free = block->next;
+        m_used++;
+        return block;
+    }
+
+    static void deallocate(void *pointer)
+    {
+        if ( !pointer )
+            return;
+
+        Block *block = static_cast<Block *>( pointer );
+        block->next = m_free;
+        m_free = block;
+        m_used--;
+    }
+
+    // releases the chunks, if no block is in use
+    static void clear()
+    {
+        if ( m_used == 0 )
+            releaseChunks();
+    }
+
+    // blocks in use and chunks allocated, for profiling
+    static int used() { return m_used; }
+    static int chunks() { return m_chunkCount; }
+
+private:
+
+    union Block
+    {
+        Block *next;
+        typename std::aligned_storage<sizeof( T ), alignof( T )>::type storage;
+    };
+
+    // the first block of a chunk links to the previous chunk
+    static void grow()
+    {
+        Block *chunk = static_cast<Block *>(
+                           ::operator new( sizeof( Block ) * ( m_chunkSize + 1 ) ) );
+        chunk[0].next = m_chunks;
+        m_chunks = chunk;
+        m_chunkCount++;
+
+        for ( int i = m_chunkSize; i > 0; i-- )
+        {
+            chunk[i].next = m_free;
+            m_free = &chunk[i];
+        }
+    }
+
+    static void releaseChunks()
+    {
+        while ( m_chunks )
+        {
+            Block *previous = m_chunks[0].next;
+            ::operator delete( m_chunks );
+            m_chunks = previous;
+        }
+
+        m_free = 0;
+        m_chunkCount = 0;
+    }
+
+    static Block *m_free;
+    static Block *m_chunks;
+    static int m_used;
+    static int m_chunkCount;
+
+    static const int m_chunkSize = 512;
+};
+
+template <typename T>
+typename ItemPool<T>::Block *ItemPool<T>::m_free = 0;
+
+template <typename T>
+typename ItemPool<T>::Block *ItemPool<T>::m_chunks = 0;
+
+template <typename T>
+int ItemPool<T>::m_used = 0;
+
+template <typename T>
+int ItemPool<T>::m_chunkCount = 0;
+
+#endif // ITEMPOOL_H
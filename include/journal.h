@@ -0,0 +1,105 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QFile>
+#include <QList>
+#include <QByteArray>
+
+// Append-only log of changes next to a map file ("map.qmm.journal").
+// Records are opaque to the journal, their first byte is a RecordType.
+// They are buffered and written + synced in batches. A Checkpoint record
+// marks the content as saved, records after the last one are unsaved.
+//
+// Compaction rewrites the map file (the base) from a snapshot, meanwhile
+// new records go to a side file (".journal.next") which replaces the
+// journal when the new base is committed. If the program dies in between,
+// recover() still finds every record exactly once.
+class Journal
+{
+public:
+
+    enum RecordType
+    {
+        NodeAdded = 1,
+        NodeState,
+        NodeRemoved,
+        EdgeAdded,
+        EdgeRemoved,
+        Checkpoint,
+        // a NodeState without the content, for Nodes only moved
+        NodePosition
+    };
+
+    Journal();
+    ~Journal();
+
+    static QString journalFileName(const QString &mapFileName);
+
+    // records of a previous session which apply to the map file.
+    // unsaved is set if records follow the last checkpoint (crash)
+    static QList<QByteArray> recover(const QString &mapFileName, bool &unsaved);
+
+    // start a new journal for the map file, seeded with recovered records
+    bool open(const QString &mapFileName,
+              const QList<QByteArray> &records = QList<QByteArray>());
+    // drop the records after the last checkpoint if needed, remove
+    // the file if nothing is left in it
+    void close(const bool &discardUnsaved = false);
+    bool isOpen() const;
+    QString mapFileName() const;
+
+    // buffered, reaches the disk with the next flush
+    void append(const QByteArray &record);
+    // marks the content as saved, flushes and syncs
+    void checkpoint();
+    bool flush();
+
+    bool hasUnsaved() const;
+    // size of the records since the last compaction
+    qint64 size() const;
+
+    // the snapshot has to be taken right after beginCompaction
+    void beginCompaction();
+    void endCompaction(const bool &committed);
+    bool isCompacting() const;
+
+private:
+
+    struct Header
+    {
+        char magic[4];
+        quint32 version;
+        // bound to a base file: its size and modification time.
+        // a side file is unbound until the new base is committed
+        quint32 bound;
+        quint32 generation;
+        // generation of the journal a side file continues
+        quint32 parent;
+        quint32 reserved;
+        qint64 baseSize;
+        qint64 baseModified;
+    };
+
+    static bool readFile(const QString &fileName, Header &header,
+                         QList<QByteArray> &records);
+    static bool matchesBase(const Header &header, const QString &mapFileName);
+    static QByteArray frame(const QByteArray &record);
+    Header header(const bool &bound) const;
+    bool writeHeader(const bool &bound);
+    bool sync();
+
+    QString m_mapFileName;
+    QFile m_file;
+    QByteArray m_buffer;
+    bool m_unsaved;
+    bool m_compacting;
+    quint32 m_generation;
+    quint32 m_parentGeneration;
+    // end of the last checkpoint in m_file
+    qint64 m_checkpointOffset;
+
+    static const char m_magic[4];
+    static const quint32 m_version;
+};
+
+#endif // JOURNAL_H
@@ -4,6 +4,7 @@
 #include <QMainWindow>
 #include <QSystemTrayIcon>
 #include <QSignalMapper>
+#include <QProgressBar>
 
 #include "graphwidget.h"
 
@@ -23,6 +24,10 @@ public:
 
     // instead of givin access to private m_ui
     void statusBarMsg(const QString &msg);
+    // progress of a background write in percent, negative hides it
+    void statusBarProgress(const int &percent);
+    // a background write of unknown progress
+    void statusBarBusy();
 
     // indicate that content has changed, modify title, save actions
     void contentChanged(const bool &changed = true);
@@ -63,6 +68,7 @@ private:
     GraphWidget *m_graphicsView;
     QString m_fileName;
     bool m_contentChanged;
+    QProgressBar *m_progressBar;
 
     // main toolbar actions
     QAction *m_addNode;
@@ -78,6 +84,9 @@ private:
     QAction *m_zoomOut;
     QAction *m_esc;
     QAction *m_hintMode;
+    QAction *m_treeLayout;
+    QAction *m_radialLayout;
+    QAction *m_forceLayout;
     QAction *m_moveNode;
     QAction *m_subtree;
     QAction *m_showMainToolbar;
@@ -0,0 +1,38 @@
+#ifndef MINDMAPFILE_H
+#define MINDMAPFILE_H
+
+#include <QString>
+#include <QAtomicInt>
+#include <QCoreApplication>
+
+#include "mindmapmodel.h"
+
+// reading and writing map files to and from a MindMapModel.
+// No GUI needed, every function can run on a worker thread.
+// The format is selected by the extension: .qmmb is binary, anything else xml
+class MindMapFile
+{
+    Q_DECLARE_TR_FUNCTIONS(MindMapFile)
+
+public:
+
+    // the model is cleared first, left empty on failure.
+    // error is set to a message for the user
+    static bool read(const QString &fileName, MindMapModel &model,
+                     QString *error = 0);
+    static bool readXml(const QString &fileName, MindMapModel &model,
+                        QString *error = 0);
+    // content of the nodes stays in the mapped file
+    static bool readBinary(const QString &fileName, MindMapModel &model,
+                           QString *error = 0);
+
+    // progress is optional, the percentage written so far is stored in it
+    static bool write(const MindMapModel &model, const QString &fileName,
+                      QAtomicInt *progress = 0);
+    static bool writeXml(const MindMapModel &model, const QString &fileName,
+                         QAtomicInt *progress = 0);
+    static bool writeBinary(const MindMapModel &model, const QString &fileName,
+                            QAtomicInt *progress = 0);
+};
+
+#endif // MINDMAPFILE_H
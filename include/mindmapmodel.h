@@ -0,0 +1,158 @@
+#ifndef MINDMAPMODEL_H
+#define MINDMAPMODEL_H
+
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QString>
+#include <QPointF>
+#include <QSizeF>
+#include <QRgb>
+#include <QFile>
+#include <QSharedPointer>
+
+// Content of a map without any GUI: usable without QApplication and on
+// any thread. Nodes and edges have dense integer IDs (0..count-1), their
+// properties are stored in parallel arrays. Node 0 is the root.
+//
+// Removing a node/edge moves the last one into its place, so IDs stay
+// dense. The remove functions return the old ID of the moved one, views
+// keeping IDs have to follow.
+//
+// Copies are cheap (implicitly shared arrays), a copy is a snapshot.
+class MindMapModel
+{
+public:
+
+    MindMapModel();
+
+    void clear();
+    int nodeCount() const;
+    int edgeCount() const;
+
+    // nodes
+    int addNode();
+    // edges of the node are removed too, without reporting moved edges:
+    // remove them one by one first if edge IDs are kept somewhere
+    int removeNode(const int &node);
+
+    QPointF pos(const int &node) const;
+    void setPos(const int &node, const QPointF &pos);
+    qreal scale(const int &node) const;
+    void setScale(const int &node, const qreal &scale);
+    // unscaled size of the content, invalid if not known (not laid out yet)
+    QSizeF size(const int &node) const;
+    void setSize(const int &node, const QSizeF &size);
+    QRgb color(const int &node) const;
+    void setColor(const int &node, const QRgb &color);
+    QRgb textColor(const int &node) const;
+    void setTextColor(const int &node, const QRgb &color);
+    // html content, stored as UTF-8
+    QByteArray content(const int &node) const;
+    void setContent(const int &node, const QByteArray &content);
+    QString html(const int &node) const;
+
+    // edges
+    int addEdge(const int &source, const int &destination);
+    int removeEdge(const int &edge);
+
+    int source(const int &edge) const;
+    int destination(const int &edge) const;
+    // the end of the edge which is not node
+    int otherEnd(const int &edge, const int &node) const;
+    QRgb edgeColor(const int &edge) const;
+    void setEdgeColor(const int &edge, const QRgb &color);
+    qreal edgeWidth(const int &edge) const;
+    void setEdgeWidth(const int &edge, const qreal &width);
+    // just a logical connection between two nodes,
+    // does not counts at subtree calculation
+    bool secondary(const int &edge) const;
+    void setSecondary(const int &edge, const bool &secondary);
+
+    // graph traversal, constant time and without allocation except subtree.
+    // A node has one parent: further primary edges to it, and the ones
+    // which would close a cycle, are indexed as secondaries
+    int edgeBetween(const int &node, const int &other) const;
+    // primary edge ending in the node, -1 for the root or a lonely node
+    int parentEdge(const int &node) const;
+    const QVector<int> &childEdges(const int &node) const;
+    // secondary edges starting or ending in the node
+    const QVector<int> &secondaryEdges(const int &node) const;
+    // all the edges of the node: incidentEdge(node, 0..degree(node)-1)
+    int degree(const int &node) const;
+    int incidentEdge(const int &node, int i) const;
+
+    // primary edges form a forest, its nodes are kept in pre-order.
+    // A subtree is a contiguous range: subtreeNode(node, 0..subtreeSize-1),
+    // the node itself first
+    int subtreeSize(const int &node) const;
+    int subtreeNode(const int &node, const int &i) const;
+    QVector<int> subtree(const int &node) const;
+    bool isAncestor(const int &ancestor, const int &node) const;
+    // source of the parent edge, -1 for a root
+    int parentNode(const int &node) const;
+    // the whole forest: preorderNode(0..nodeCount-1), roots and their ranges
+    int preorderNode(const int &i) const;
+    // position of the node in it: preorderNode(preorderIndex(node)) == node
+    int preorderIndex(const int &node) const;
+
+    // adding many edges (loading): the pre-order is built once at the end,
+    // it is not valid meanwhile
+    void beginBulkUpdate();
+    void endBulkUpdate();
+
+    // keeps the mapped file alive while any copy refers to its content
+    void setMappedFile(const QSharedPointer<QFile> &file);
+
+private:
+
+    void linkEdge(const int &edge);
+    void linkSecondary(const int &edge);
+    void unlinkEdge(const int &edge);
+    void takeSlot(QVector<int> &list, const int &node, const int &slot);
+    void renameEnd(const int &edge, const int &from, const int &to);
+
+    // pre-order maintenance
+    void attachSubtree(const int &node, const int &parent);
+    void detachSubtree(const int &node);
+    void moveBlock(const int &from, const int &length, const int &to);
+    void rebuildPreorder();
+    void appendPreorder(const int &root);
+
+    // nodes
+    QVector<QPointF> m_pos;
+    QVector<qreal> m_scale;
+    QVector<QSizeF> m_size;
+    QVector<QRgb> m_color;
+    QVector<QRgb> m_textColor;
+    QVector<QByteArray> m_content;
+
+    // adjacency of the nodes
+    QVector<int> m_parentEdge;
+    QVector<QVector<int> > m_childEdges;
+    QVector<QVector<int> > m_secondaryEdges;
+    // pre-order of the primary forest, position and subtree size of nodes
+    QVector<int> m_order;
+    QVector<int> m_first;
+    QVector<int> m_subtreeSize;
+    bool m_bulkUpdate;
+
+    // edges
+    QVector<int> m_source;
+    QVector<int> m_destination;
+    QVector<QRgb> m_edgeColor;
+    QVector<qreal> m_edgeWidth;
+    QVector<bool> m_secondary;
+    // index of the edge in the child or secondary list of its source and in
+    // the secondary list of its destination (-1: it is the parent edge there)
+    QVector<int> m_sourceSlot;
+    QVector<int> m_destinationSlot;
+    // edges by their unordered pair of nodes
+    QMultiHash<quint64, int> m_edgeIndex;
+
+    QSharedPointer<QFile> m_mappedFile;
+
+    static const QRgb m_defaultColor;
+};
+
+#endif // MINDMAPMODEL_H
@@ -3,7 +3,6 @@
 
 #include <QGraphicsTextItem>
 #include <QTextCursor>
-#include <QGraphicsDropShadowEffect>
 
 #include "edge.h"
 #include "graphwidget.h"
@@ -14,20 +13,23 @@ class Node : public QGraphicsTextItem
 {
 public:
 
-    Node(GraphWidget *graphWidget = 0);
-    ~Node();
+    // view of the node with this ID in the GraphWidget's model
+    Node(GraphWidget *graphWidget, const int &id);
 
-    // add/remove edges
-    void addEdge(Edge *edge, bool startsFromThisNode);
-    void deleteEdge(Node *otherEnd);
-    void removeEdgeFromList(Edge *edge);
+    // views come from an ItemPool, a map is released in a few chunks
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer);
 
-    // graph traversal
-    QList<Edge *> edgesFrom(const bool &excludeSecondaries = true) const;
-    QList<Edge *> edgesToThis(const bool &excludeSecondaries = true) const;
+    // the model moves nodes to keep IDs dense, GraphWidget follows it
+    int id() const;
+    void setId(const int &id);
+
+    // graph traversal, through the adjacency and subtree index of the model.
+    // subtree() is in pre-order, the node itself first
     Edge * edgeTo(const Node* node) const;
     QList<Node *> subtree() const;
     bool isConnected(const Node *node) const;
+    void adjustEdges();
 
     // prop set/get
     void setBorder(const bool &hasBorder = true);
@@ -36,19 +38,38 @@ public:
     QColor color() const;
     void setTextColor(const QColor &color);
     QColor textColor() const;
-    void setScale(const qreal &factor, const QRectF &sceneRect);
+    // relative to the current scale, the scene grows if needed
+    void setScale(const qreal &factor);
+
+    // level of detail (scale of the view) below which Nodes are drawn
+    // without rich text: a rounded rect with a caption, under blockDetail
+    // just a block of color
+    static void setDetailThresholds(const qreal &textDetail, const qreal &blockDetail);
 
-    // show numbers in hint mode
+    // show numbers in hint mode, with leading zeros up to digits.
+    // Repainted only if it changes
     void showNumber(const int &number, const bool& show = true,
-                    const bool &numberIsSpecial = false);
+                    const bool &numberIsSpecial = false, const int &digits = 1);
     // insert picture to the cursor's current position
     void insertPicture(const QString &picture);
 
+    // take position, scale and content from the model. The content stays
+    // there, it is drawn from it and only decoded into the QTextDocument of
+    // the Node while it is edited
+    void loadFromModel();
+    // write edited content and its size back to the model
+    void syncContent();
+    // the content and, with a border, its shadow
+    QRectF boundingRect() const;
+    // the rounded rect of the Node itself
+    QRectF contentRect() const;
+
     // changing visibility from prot to pub
     // so GraphWidget::keyPressEvent can call it edit during editing
     void keyPressEvent(QKeyEvent *event);
 
-    // calculetes the intersection of line and shape of this Node
+    // calculetes the intersection of line and shape of this Node.
+    // Exact, without sampling or allocation
     QPointF intersection(const QLineF &line, const bool &reverse = false) const;
 
     // returns with the biggest angle between the edges
@@ -67,29 +88,59 @@ protected:
 
 private:
 
+    void contentEdited();
+    // the editor: the document of the QGraphicsTextItem, filled with the
+    // content when editing starts, cleared after it was written back
+    void openEditor();
+    void closeEditor();
+    void clearEditor();
+    QTextDocument *layout(const QString &html) const;
+    void paintLowDetail(QPainter *painter, const qreal &detail);
+    // full detail drawing, directly or through the shared RenderCache
+    void paintContent(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+    void paintCached(QPainter *painter, const QStyleOptionGraphicsItem *option,
+                     QWidget *widget, const qreal &detail);
+    QString renderKey();
+    static const QPixmap &shadow();
+    // the QTextDocument is created with the first edit, not with the Node
+    void connectDocument();
     double doubleModulo(const double &devided, const double &devisor) const;
+    static bool outsideCorner(const QPointF &point, const QPointF &center,
+                              const qreal &innerX, const qreal &innerY,
+                              const qreal &rx, const qreal &ry);
 
-    struct EdgeElement
-    {
-        Edge *edge;
-        bool startsFromThisNode;
-        EdgeElement(Edge *e, bool s) : edge(e), startsFromThisNode(s) {}
-    };
-
-    QList<EdgeElement> m_edgeList;
     GraphWidget *m_graph;
+    int m_id;
     int m_number;
     bool m_hasBorder;
     bool m_numberIsSpecial;
-    QColor m_color;
-    QColor m_textColor;
-    QGraphicsDropShadowEffect *m_effect;
+    int m_numberDigits;
+
+    // the content is in the document of the QGraphicsTextItem
+    bool m_editing;
+    // setting content from the model, not an edit
+    bool m_loadingContent;
+    bool m_contentEdited;
+    bool m_documentConnected;
+    // first line of the content for low detail, null if not calculated
+    QString m_caption;
+    // content part of the render cache key, null if not calculated
+    QString m_renderKey;
 
     static const double m_pi;
     static const double m_oneAndHalfPi;
     static const double m_twoPi;
-
-    static const QColor m_gold;
+    // of the rounded rectangle, in item coordinates
+    static const qreal m_cornerRadiusX;
+    static const qreal m_cornerRadiusY;
+    static qreal m_textDetail;
+    static qreal m_blockDetail;
+    // renderings bigger than this are not cached, in pixels
+    static const qreal m_maxRenderSize;
+    static quint64 m_editSerial;
+    static const qreal m_shadowOffset;
+    static const int m_shadowBlur;
+    static const QColor m_shadowColor;
 };
 
 #endif // NODE_H
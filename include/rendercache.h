@@ -0,0 +1,34 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QString>
+#include <QPixmap>
+
+// renderings of Nodes, shared by all of them in one LRU cache
+// (QPixmapCache) with a memory budget. A rendering is keyed by what it
+// shows and by a zoom bucket: buckets are the 1.2x steps of the zoom,
+// so identical Nodes share pixmaps and a zoom level is rendered once
+class RenderCache
+{
+public:
+
+    static void setBudget(const int &kilobytes);
+    static int budget();
+
+    static int bucket(const qreal &detail);
+    static qreal bucketScale(const int &bucket);
+
+    static bool find(const QString &key, const int &bucket, QPixmap &pixmap);
+    // the rendering of the closest bucket, within a few steps
+    static bool findNearest(const QString &key, const int &bucket, QPixmap &pixmap);
+    static void insert(const QString &key, const int &bucket, const QPixmap &pixmap);
+
+private:
+
+    static QString bucketKey(const QString &key, const int &bucket);
+
+    static const qreal m_step;
+    static const int m_nearest;
+};
+
+#endif // RENDERCACHE_H
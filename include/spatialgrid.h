@@ -0,0 +1,71 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QRectF>
+#include <QRect>
+#include <QLineF>
+#include <QVector>
+#include <QHash>
+
+// Uniform grid over the scene: items with dense IDs (Nodes or Edges of
+// the model) are registered in every cell they touch. A rect covers the
+// cells of its area, a line only the cells along it: a long diagonal edge
+// costs its length in cells, not the area of its bounding rect.
+// Updating an item which stays in its cells is only a store, a query
+// visits the cells of the area, or every non-empty cell if there are fewer.
+// IDs follow the model: removing an item moves the last one to its place
+class SpatialGrid
+{
+public:
+
+    SpatialGrid(const qreal &cellSize = 256);
+
+    void clear();
+    int size() const;
+
+    // inserts the item if it is new, IDs beyond the size grow the grid
+    void update(const int &id, const QRectF &rect);
+    // a line drawn margin wide around it on each side (pen, arrow head),
+    // found by the areas it passes through
+    void update(const int &id, const QLineF &line, const qreal &margin);
+    // the last item takes the ID, like MindMapModel::removeNode/removeEdge
+    void remove(const int &id);
+    // bounding rect of the item
+    QRectF rect(const int &id) const;
+    // united rect of all the items, null if there is none
+    QRectF bounds() const;
+
+    // IDs of the items intersecting area, each once
+    QVector<int> query(const QRectF &area) const;
+
+private:
+
+    // cell coordinates covered by a rect
+    QRect cells(const QRectF &rect) const;
+    // keys of the cells of a rect, or of a line column by column
+    void rectCells(const QRectF &rect, QVector<quint64> &keys) const;
+    void lineCells(const QLineF &line, const qreal &margin, QVector<quint64> &keys) const;
+    // stores the item, relinks it if its cells changed
+    void place(const int &id, const QRectF &rect);
+    bool intersects(const int &id, const QRectF &area) const;
+    static quint64 key(const int &x, const int &y);
+    void link(const int &id, const QVector<quint64> &keys);
+    void unlink(const int &id, const QVector<quint64> &keys);
+
+    qreal m_cellSize;
+    // bounding rects, and the lines of line items (negative margin: a rect)
+    QVector<QRectF> m_rects;
+    QVector<QLineF> m_lines;
+    QVector<qreal> m_margins;
+    // cells of the items, empty if not registered yet
+    QVector<QVector<quint64> > m_cells;
+    QHash<quint64, QVector<int> > m_grid;
+    // cells of the item being updated, its capacity is reused
+    QVector<quint64> m_newCells;
+
+    // stamps to report an item covering several cells only once
+    mutable QVector<int> m_seen;
+    mutable int m_stamp;
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,99 @@
+#ifndef TREELAYOUT_H
+#define TREELAYOUT_H
+
+#include <QVector>
+#include <QPointF>
+#include <QSizeF>
+
+#include "mindmapmodel.h"
+
+// Tidy tree layout of the primary edges (Walker's algorithm in the linear
+// time version of Buchheim et al.), without any GUI. Nodes are placed in
+// layers by depth, siblings in the order they have on the map, with the
+// scaled sizes of the model. The root of the laid out tree stays in place.
+//
+// Results are in pre-order of the subtree: subtreeNode(root, i) of the
+// model goes to pos(i), the top left corner as MindMapModel::pos
+class TreeLayout
+{
+public:
+
+    enum Style
+    {
+        // not laid out, nodes are where the user put them
+        Manual,
+        // children of the root split to its right and left
+        LeftRight,
+        // layers on circles around the root
+        Radial
+    };
+
+    TreeLayout(const MindMapModel &model);
+
+    // the whole tree of the root
+    void layoutTree(const int &root, const Style &style);
+    // the subtree fanned out from its root in direction (radians):
+    // re-layout of a part of a map after a change
+    void layoutSubtree(const int &root, const qreal &direction);
+
+    int count() const;
+    QPointF pos(const int &i) const;
+
+private:
+
+    // tidy tree of the root with the given children of it only,
+    // layers along axis (angle) or on circles
+    void fan(const QVector<int> &rootChildren, const qreal &angle, const bool &circular);
+    void prepare(const QVector<int> &rootChildren, const qreal &angle, const bool &circular);
+    void firstWalk();
+    void secondWalk();
+    void placeAlong(const qreal &angle);
+    void placeAround();
+
+    // the steps of Buchheim's algorithm
+    int apportion(const int &v, int defaultAncestor);
+    void moveSubtree(const int &left, const int &right, const qreal &shift);
+    void executeShifts(const int &v);
+    int nextLeft(const int &v) const;
+    int nextRight(const int &v) const;
+    int ancestor(const int &vil, const int &v, const int &defaultAncestor) const;
+    qreal separation(const int &left, const int &right) const;
+    qreal chordRadius(const int &left, const int &right, const qreal &angle) const;
+
+    QPointF center(const int &node) const;
+    QSizeF scaledSize(const int &node) const;
+    // local index: position in the pre-order of the subtree
+    int local(const int &node) const;
+
+    const MindMapModel &m_model;
+    int m_root;
+    int m_base;
+    QVector<QPointF> m_pos;
+
+    // per local index: the included nodes and their children sorted
+    QVector<bool> m_included;
+    QVector<int> m_parent;
+    QVector<int> m_level;
+    QVector<int> m_childStart;
+    QVector<int> m_childCount;
+    QVector<int> m_children;
+    // extents along and across the layers
+    QVector<qreal> m_breadth;
+    QVector<qreal> m_depth;
+
+    QVector<qreal> m_prelim;
+    QVector<qreal> m_mod;
+    QVector<qreal> m_change;
+    QVector<qreal> m_shift;
+    QVector<qreal> m_midpoint;
+    QVector<int> m_thread;
+    QVector<int> m_ancestor;
+    QVector<int> m_number;
+    // position across the layers after the second walk
+    QVector<qreal> m_across;
+
+    static const qreal m_nodeGap;
+    static const qreal m_levelGap;
+};
+
+#endif // TREELAYOUT_H
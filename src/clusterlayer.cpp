@@ -0,0 +1,113 @@
+#include "include/clusterlayer.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "include/graphwidget.h"
+
+const qreal ClusterLayer::m_glyphSize = 48;
+
+ClusterLayer::ClusterLayer( GraphWidget* graph ) :
+    m_graph( graph ),
+    m_boundsValid( false )
+{
+    setAcceptedMouseButtons( 0 );
+    setZValue( 2 );
+    setFlag( ItemUsesExtendedStyleOption );
+}
+
+void ClusterLayer::invalidate()
+{
+    m_boundsValid = false;
+
+    if ( isVisible() )
+        update();
+}
+
+void ClusterLayer::setRect( const QRectF& rect )
+{
+    prepareGeometryChange();
+    m_rect = rect;
+}
+
+QRectF ClusterLayer::boundingRect() const
+{
+    return m_rect;
+}
+
+void ClusterLayer::calculateBounds()
+{
+    const MindMapModel& model = m_graph->model();
+    m_bounds.resize( model.nodeCount() );
+
+    for ( int i = 0; i < model.nodeCount(); i++ )
+        m_bounds[i] = m_graph->node( i )->sceneBoundingRect();
+
+    // children follow their parent in pre-order: backwards, every
+    // subtree is complete by the time it is added to its parent
+    for ( int i = model.nodeCount() - 1; i >= 0; i-- )
+    {
+        const int node = model.preorderNode( i );
+        const int parent = model.parentNode( node );
+
+        if ( parent != -1 )
+            m_bounds[parent] = m_bounds.at( parent ).united( m_bounds.at( node ) );
+    }
+
+    m_boundsValid = true;
+}
+
+void ClusterLayer::paint( QPainter* painter, const QStyleOptionGraphicsItem* option,
+                          QWidget* widget )
+{
+    Q_UNUSED( widget );
+
+    if ( !m_boundsValid )
+        calculateBounds();
+
+    const MindMapModel& model = m_graph->model();
+    const QRectF exposed = option->exposedRect;
+    const qreal detail = QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                             painter->worldTransform() );
+    int i( 0 );
+
+    // subtrees are skipped or drawn as a whole by jumping over their range
+    while ( i < model.nodeCount() )
+    {
+        const int node = model.preorderNode( i );
+        const int size = model.subtreeSize( node );
+        const QRectF& bounds = m_bounds.at( node );
+        const QColor color( model.color( node ) );
+
+        if ( !bounds.intersects( exposed ) )
+        {
+            i += size;
+            continue;
+        }
+
+        // big on the screen: the root alone, its children get their turn
+        if ( size == 1 || qMax( bounds.width(), bounds.height() ) * detail > m_glyphSize )
+        {
+            painter->fillRect( m_graph->node( node )->sceneBoundingRect(), color );
+            i++;
+            continue;
+        }
+
+        QColor fill( color );
+        fill.setAlpha( 160 );
+        painter->setPen( QPen( color.darker(), 0 ) );
+        painter->setBrush( fill );
+        painter->drawRoundedRect( bounds, bounds.width() / 8, bounds.height() / 8 );
+
+        // number of descendants, in a size readable on the screen
+        painter->save();
+        painter->translate( bounds.center() );
+        painter->scale( 1 / detail, 1 / detail );
+        painter->setPen( Qt::black );
+        painter->drawText( QRectF( -m_glyphSize, -m_glyphSize, 2 * m_glyphSize, 2 * m_glyphSize ),
+                           Qt::AlignCenter, QString::number( size - 1 ) );
+        painter->restore();
+
+        i += size;
+    }
+}
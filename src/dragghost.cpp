@@ -0,0 +1,121 @@
+#include "include/dragghost.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <qmath.h>
+
+#include "include/graphwidget.h"
+#include "include/edge.h"
+
+const qreal DragGhost::m_maxPixmapSize = 2048;
+const qreal DragGhost::m_opacity = 0.75;
+
+DragGhost::DragGhost( GraphWidget* graph, const int& root, const qreal& zoom ) :
+    m_graph( graph ),
+    m_margin( 0 )
+{
+    setAcceptedMouseButtons( 0 );
+    setZValue( 3 );
+    render( root, zoom );
+}
+
+void DragGhost::drag( const QPointF& offset )
+{
+    // the boundary lines stretch, the bounding rect changes
+    prepareGeometryChange();
+    setPos( pos() + offset );
+}
+
+QPointF DragGhost::offset() const
+{
+    return pos();
+}
+
+QRectF DragGhost::boundingRect() const
+{
+    QRectF rect = m_rect;
+
+    foreach ( const QLineF & line, m_boundary )
+        rect = rect.united( QRectF( line.p1() - pos(), line.p2() ).normalized() );
+
+    return rect.adjusted( -m_margin, -m_margin, m_margin, m_margin );
+}
+
+void DragGhost::paint( QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget )
+{
+    Q_UNUSED( option );
+    Q_UNUSED( widget );
+
+    painter->setOpacity( m_opacity );
+
+    for ( int i = 0; i < m_boundary.size(); i++ )
+    {
+        painter->setPen( m_boundaryPens.at( i ) );
+        painter->drawLine( m_boundary.at( i ).p1() - pos(), m_boundary.at( i ).p2() );
+    }
+
+    painter->setRenderHint( QPainter::SmoothPixmapTransform );
+    painter->drawPixmap( m_rect, m_pixmap, QRectF( m_pixmap.rect() ) );
+}
+
+// the Nodes and the inner edges painted as the scene paints them,
+// the edges leaving the subtree are kept as lines
+void DragGhost::render( const int& root, const qreal& zoom )
+{
+    const MindMapModel& model = m_graph->model();
+    QList<QGraphicsItem*> items;
+
+    for ( int i = 0; i < model.subtreeSize( root ); i++ )
+    {
+        const int node = model.subtreeNode( root, i );
+
+        for ( int j = 0; j < model.degree( node ); j++ )
+        {
+            const int edge = model.incidentEdge( node, j );
+            const int other = model.otherEnd( edge, node );
+            Edge* view = m_graph->edge( edge );
+
+            if ( !model.isAncestor( root, other ) )
+            {
+                m_boundary.append( QLineF( m_graph->node( other )->sceneBoundingRect().center(),
+                                           m_graph->node( node )->sceneBoundingRect().center() ) );
+                m_boundaryPens.append( QPen( view->color(), view->width(),
+                                             view->secondary() ? Qt::DashLine : Qt::SolidLine,
+                                             Qt::RoundCap ) );
+                m_margin = qMax( m_margin, view->width() / 2 + 1 );
+            }
+            else if ( model.source( edge ) == node )
+            {
+                items.append( view );
+                m_rect = m_rect.united( view->boundingRect() );
+            }
+        }
+    }
+
+    // Nodes over the edges
+    for ( int i = 0; i < model.subtreeSize( root ); i++ )
+    {
+        Node* node = m_graph->node( model.subtreeNode( root, i ) );
+        items.append( node );
+        m_rect = m_rect.united( node->sceneBoundingRect() );
+    }
+
+    const qreal scale = qMin( zoom, m_maxPixmapSize / qMax( m_rect.width(), m_rect.height() ) );
+    m_pixmap = QPixmap( qCeil( m_rect.width() * scale ), qCeil( m_rect.height() * scale ) );
+    m_pixmap.fill( Qt::transparent );
+
+    QPainter painter( &m_pixmap );
+    painter.setRenderHint( QPainter::Antialiasing );
+    painter.scale( scale, scale );
+    painter.translate( -m_rect.topLeft() );
+    QStyleOptionGraphicsItem style;
+
+    foreach ( QGraphicsItem * item, items )
+    {
+        painter.save();
+        painter.setTransform( item->sceneTransform(), true );
+        style.exposedRect = item->boundingRect();
+        item->paint( &painter, &style, 0 );
+        painter.restore();
+    }
+}
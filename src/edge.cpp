@@ -4,6 +4,8 @@
 
 #include "include/edge.h"
 #include "include/node.h"
+#include "include/itempool.h"
+#include "include/edgelayer.h"
 
 #include <math.h>
 
@@ -11,22 +13,36 @@ const double Edge::m_pi = 3.14159265358979323846264338327950288419717;
 const double Edge::m_twoPi = 2.0 * Edge::m_pi;
 const qreal Edge::m_arrowSize = 7;
 
-Edge::Edge( Node* sourceNode, Node* destNode ) : m_angle( -1 ) , m_color( 0, 0, 0 ) , m_width( 1 ) , m_secondary( false )
+Edge::Edge( GraphWidget* graph, Node* sourceNode, Node* destNode, const int& id ) : m_graph( graph ) , m_id( id ) , m_angle( -1 ) , m_length( 0 ) , m_overlap( false )
 {
     // does not interact with user
     setAcceptedMouseButtons( 0 );
     setZValue( 1 );
     m_sourceNode = sourceNode;
     m_destNode = destNode;
-    m_sourceNode->addEdge( this, true );
-    m_destNode->addEdge( this, false );
     adjust();
 }
 
-Edge::~Edge()
+void* Edge::operator new( size_t size )
 {
-    m_sourceNode->removeEdgeFromList( this );
-    m_destNode->removeEdgeFromList( this );
+    Q_ASSERT( size == sizeof( Edge ) );
+    Q_UNUSED( size );
+    return ItemPool<Edge>::allocate();
+}
+
+void Edge::operator delete( void* pointer )
+{
+    ItemPool<Edge>::deallocate( pointer );
+}
+
+int Edge::id() const
+{
+    return m_id;
+}
+
+void Edge::setId( const int& id )
+{
+    m_id = id;
 }
 
 Node* Edge::sourceNode() const
@@ -46,18 +62,18 @@ double Edge::angle() const
 
 QColor Edge::color() const
 {
-    return m_color;
+    return QColor( m_graph->model().edgeColor( m_id ) );
 }
 
 void Edge::setColor( const QColor& color )
 {
-    m_color = color;
-    update();
+    m_graph->model().setEdgeColor( m_id, color.rgb() );
+    redraw( boundingRect() );
 }
 
 qreal Edge::width() const
 {
-    return m_width;
+    return m_graph->model().edgeWidth( m_id );
 }
 
 void Edge::setWidth( const qreal& width )
@@ -65,28 +81,93 @@ void Edge::setWidth( const qreal& width )
     if ( width < 1 || width > 100 )
         return;
 
-    m_width = width;
-    update();
+    m_graph->model().setEdgeWidth( m_id, width );
+    // bounding rect and arrow grow with the width
+    adjust();
 }
 
 bool Edge::secondary() const
 {
-    return m_secondary;
+    return m_graph->model().secondary( m_id );
 }
 
 void Edge::setSecondary( const bool& sec )
 {
-    m_secondary = sec;
-    update();
+    m_graph->model().setSecondary( m_id, sec );
+    redraw( boundingRect() );
 }
 
+// everything paint() needs is calculated here, not at every repaint
 void Edge::adjust()
 {
+    const QRectF before = boundingRect();
     prepareGeometryChange();
-    QLineF line( m_sourceNode->sceneBoundingRect().center(),
-                 m_destNode->sceneBoundingRect().center() );
+    const QPointF sourceCenter = m_sourceNode->sceneBoundingRect().center();
+    const QLineF line( sourceCenter, m_destNode->sceneBoundingRect().center() );
     m_destPoint = m_destNode->intersection( line, true );
-    m_sourcePoint = m_sourceNode->sceneBoundingRect().center();
+    m_sourcePoint = sourceCenter;
+
+    const QLineF edgeLine( m_sourcePoint, m_destPoint );
+    m_length = edgeLine.length();
+    m_angle = m_length > 0 ? ::acos( edgeLine.dx() / m_length ) : 0;
+
+    if ( edgeLine.dy() >= 0 )
+        m_angle = Edge::m_twoPi - m_angle;
+
+    // no need to draw when the nodes overlap
+    m_overlap = m_sourceNode->collidesWithItem( m_destNode );
+
+    // arrow at the end of the line, if there is room for it
+    m_arrowHead = QPainterPath();
+    const qreal arrowSize = m_arrowSize + width();
+
+    if ( m_length >= arrowSize )
+    {
+        m_arrowHead.moveTo( m_destPoint );
+        m_arrowHead.lineTo( m_destPoint + QPointF( sin( m_angle - Edge::m_pi / 3 ) * arrowSize,
+                                                   cos( m_angle - Edge::m_pi / 3 ) * arrowSize ) );
+        m_arrowHead.lineTo( m_destPoint + QPointF( sin( m_angle - Edge::m_pi + Edge::m_pi / 3 ) * arrowSize,
+                                                   cos( m_angle - Edge::m_pi + Edge::m_pi / 3 ) * arrowSize ) );
+        m_arrowHead.closeSubpath();
+    }
+
+    m_graph->updateIndex( this );
+
+    if ( !scene() )
+    {
+        redraw( before );
+        redraw( boundingRect() );
+    }
+}
+
+QPointF Edge::sourcePoint() const
+{
+    return m_sourcePoint;
+}
+
+QPointF Edge::destPoint() const
+{
+    return m_destPoint;
+}
+
+qreal Edge::length() const
+{
+    return m_length;
+}
+
+bool Edge::overlap() const
+{
+    return m_overlap;
+}
+
+const QPainterPath& Edge::arrowHead() const
+{
+    return m_arrowHead;
+}
+
+qreal Edge::arrowSize()
+{
+    return m_arrowSize;
 }
 
 QRectF Edge::boundingRect() const
@@ -95,44 +176,61 @@ QRectF Edge::boundingRect() const
         return QRectF();
 
     qreal penWidth = 1;
-    qreal extra = ( penWidth + m_arrowSize  + m_width ) / 2.0;
+    qreal extra = ( penWidth + m_arrowSize  + width() ) / 2.0;
     return QRectF( m_sourcePoint, QSizeF( m_destPoint.x() - m_sourcePoint.x(), m_destPoint.y() - m_sourcePoint.y() ) ) .normalized().adjusted( -extra, -extra, extra, extra );
 }
 
 void Edge::paint( QPainter* painter, const QStyleOptionGraphicsItem*, QWidget* w )
 {
     Q_UNUSED( w );
-    // calculate angle
-    QLineF line( m_sourcePoint, m_destPoint );
-    m_angle = ::acos( line.dx() / line.length() );
 
-    if ( line.dy() >= 0 )
-        m_angle = Edge::m_twoPi - m_angle;
-
-    // no need to draw when the nodes overlap
-    if ( sourceNode()->collidesWithItem( destNode() ) )
+    if ( m_overlap )
         return;
 
+    const QColor edgeColor = color();
+    const qreal edgeWidth = width();
+
     // Draw the line itself - if secondary then dashline
-    painter->setPen( QPen( m_color, m_width, m_secondary ? Qt::DashLine : Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin ) );
-    painter->drawLine( line );
+    painter->setPen( QPen( edgeColor, edgeWidth, secondary() ? Qt::DashLine : Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin ) );
+    painter->drawLine( m_sourcePoint, m_destPoint );
 
-    if ( line.length() < m_arrowSize )
+    if ( m_length < m_arrowSize )
         return;
 
     // Draw the arrow
-    painter->setPen( QPen( m_color, m_width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin ) );
-    painter->setBrush( m_color );
-    qreal arrowSize = m_arrowSize + m_width;
+    painter->setPen( QPen( edgeColor, edgeWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin ) );
+    painter->setBrush( edgeColor );
 
     // no need to draw the arrow if the nodes are too close
-    if ( line.length() < arrowSize )
+    if ( m_arrowHead.isEmpty() )
     {
         painter->drawLine( m_sourcePoint, m_destPoint );
         return;
     }
 
-    QPointF destArrowP1 = m_destPoint + QPointF( sin( m_angle - Edge::m_pi / 3 ) * arrowSize, cos( m_angle - Edge::m_pi / 3 ) * arrowSize );
-    QPointF destArrowP2 = m_destPoint + QPointF( sin( m_angle - Edge::m_pi + Edge::m_pi / 3 ) * arrowSize, cos( m_angle - Edge::m_pi + Edge::m_pi / 3 ) * arrowSize );
-    painter->drawPolygon( QPolygonF() << line.p2() << destArrowP1 << destArrowP2 );
+    painter->drawPath( m_arrowHead );
+}
+
+void Edge::translate( const QPointF& offset )
+{
+    const QRectF before = boundingRect();
+    prepareGeometryChange();
+    m_sourcePoint += offset;
+    m_destPoint += offset;
+    m_arrowHead.translate( offset );
+    m_graph->updateIndex( this );
+
+    if ( !scene() )
+    {
+        redraw( before );
+        redraw( boundingRect() );
+    }
+}
+
+void Edge::redraw( const QRectF& rect )
+{
+    if ( scene() )
+        update( rect );
+    else
+        m_graph->edgeLayer()->edgeChanged( rect );
 }
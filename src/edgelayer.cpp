@@ -0,0 +1,103 @@
+#include "include/edgelayer.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QMap>
+
+#include "include/graphwidget.h"
+#include "include/edge.h"
+
+bool EdgeLayer::LineStyle::operator<( const LineStyle& other ) const
+{
+    if ( color != other.color )
+        return color < other.color;
+
+    if ( width != other.width )
+        return width < other.width;
+
+    return dashed < other.dashed;
+}
+
+EdgeLayer::EdgeLayer( GraphWidget* graph ) :
+    m_graph( graph )
+{
+    setAcceptedMouseButtons( 0 );
+    setZValue( 1 );
+    // paint gets the exposed rect, edges outside of it are skipped
+    setFlag( ItemUsesExtendedStyleOption );
+}
+
+void EdgeLayer::edgeChanged( const QRectF& rect )
+{
+    update( rect );
+}
+
+void EdgeLayer::setRect( const QRectF& rect )
+{
+    prepareGeometryChange();
+    m_rect = rect;
+}
+
+QRectF EdgeLayer::boundingRect() const
+{
+    // edges never leave the scene: it grows around the Nodes
+    return m_rect;
+}
+
+void EdgeLayer::paint( QPainter* painter, const QStyleOptionGraphicsItem* option,
+                       QWidget* widget )
+{
+    Q_UNUSED( widget );
+    const QRectF exposed = option->exposedRect;
+    QMap<LineStyle, QVector<QLineF> > lines;
+    // arrows are solid, filled with the color of the line
+    QMap<LineStyle, QPainterPath> arrows;
+
+    // only the edges in the exposed area, from the spatial index
+    foreach ( int i, m_graph->edgesIn( exposed ) )
+    {
+        const Edge* edge = m_graph->edge( i );
+
+        if ( edge->overlap() )
+            continue;
+
+        LineStyle style;
+        style.color = m_graph->model().edgeColor( i );
+        style.width = m_graph->model().edgeWidth( i );
+        style.dashed = m_graph->model().secondary( i );
+        const QLineF line( edge->sourcePoint(), edge->destPoint() );
+        lines[style].append( line );
+
+        if ( edge->length() < Edge::arrowSize() )
+            continue;
+
+        style.dashed = false;
+
+        // no room for the arrow: the line is drawn solid, like Edge::paint
+        if ( edge->arrowHead().isEmpty() )
+            lines[style].append( line );
+        else
+            arrows[style].addPath( edge->arrowHead() );
+    }
+
+    painter->setBrush( Qt::NoBrush );
+
+    for ( QMap<LineStyle, QVector<QLineF> >::const_iterator it = lines.constBegin();
+          it != lines.constEnd(); ++it )
+    {
+        painter->setPen( QPen( QColor( it.key().color ), it.key().width,
+                               it.key().dashed ? Qt::DashLine : Qt::SolidLine,
+                               Qt::RoundCap, Qt::RoundJoin ) );
+        painter->drawLines( it.value() );
+    }
+
+    for ( QMap<LineStyle, QPainterPath>::const_iterator it = arrows.constBegin();
+          it != arrows.constEnd(); ++it )
+    {
+        const QColor color( it.key().color );
+        painter->setPen( QPen( color, it.key().width, Qt::SolidLine,
+                               Qt::RoundCap, Qt::RoundJoin ) );
+        painter->setBrush( color );
+        painter->drawPath( it.value() );
+    }
+}
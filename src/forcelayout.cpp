@@ -0,0 +1,316 @@
+#include "include/forcelayout.h"
+
+#include <QtConcurrent>
+#include <QMutexLocker>
+#include <QSizeF>
+
+#include <cmath>
+
+const float ForceLayout::m_idealLength = 80;
+const float ForceLayout::m_primaryStiffness = 0.4f;
+const float ForceLayout::m_secondaryStiffness = 0.1f;
+const float ForceLayout::m_theta = 0.8f;
+const float ForceLayout::m_softening = 1;
+const float ForceLayout::m_cooling = 0.97f;
+const float ForceLayout::m_frozen = 0.5f;
+const int ForceLayout::m_maxIterations = 1000;
+// nodes in the same point would be split forever
+const int ForceLayout::m_maxDepth = 24;
+const int ForceLayout::m_rangeSize = 512;
+
+ForceLayout::ForceLayout() :
+    m_stop( 0 ),
+    m_fresh( false )
+{
+}
+
+ForceLayout::~ForceLayout()
+{
+    stop();
+}
+
+void ForceLayout::start( const MindMapModel& model )
+{
+    stop();
+    m_model = model;
+    const int count = m_model.nodeCount();
+    m_x.resize( count );
+    m_y.resize( count );
+    m_fx.fill( 0, count );
+    m_fy.fill( 0, count );
+    m_halfWidth.resize( count );
+    m_halfHeight.resize( count );
+    m_radius.resize( count );
+
+    for ( int i = 0; i < count; i++ )
+    {
+        QSizeF size = m_model.size( i );
+        size = size.isValid() ? size * m_model.scale( i ) : QSizeF( 0, 0 );
+        m_halfWidth[i] = size.width() / 2;
+        m_halfHeight[i] = size.height() / 2;
+        m_radius[i] = std::sqrt( m_halfWidth.at( i ) * m_halfWidth.at( i ) +
+                                 m_halfHeight.at( i ) * m_halfHeight.at( i ) );
+        m_x[i] = m_model.pos( i ).x() + m_halfWidth.at( i );
+        m_y[i] = m_model.pos( i ).y() + m_halfHeight.at( i );
+    }
+
+    m_fresh = false;
+    m_stop.store( 0 );
+    m_future = QtConcurrent::run( this, &ForceLayout::run );
+}
+
+void ForceLayout::stop()
+{
+    m_stop.store( 1 );
+    m_future.waitForFinished();
+}
+
+bool ForceLayout::isRunning() const
+{
+    return m_future.isRunning();
+}
+
+bool ForceLayout::takePositions( QVector<QPointF>& positions )
+{
+    QMutexLocker locker( &m_mutex );
+
+    if ( !m_fresh )
+        return false;
+
+    positions = m_positions;
+    m_fresh = false;
+    return true;
+}
+
+void ForceLayout::run()
+{
+    if ( m_model.nodeCount() < 2 )
+        return;
+
+    QVector<Range> ranges;
+
+    for ( int i = 0; i < m_model.nodeCount(); i += m_rangeSize )
+    {
+        Range range = { this, i, qMin( i + m_rangeSize, m_model.nodeCount() ) };
+        ranges.append( range );
+    }
+
+    // far moves first, smaller and smaller ones as the map cools down
+    float temperature = m_idealLength * std::sqrt( float( m_model.nodeCount() ) ) / 4;
+
+    for ( int i = 0; i < m_maxIterations && temperature > m_frozen; i++ )
+    {
+        if ( m_stop.load() )
+            return;
+
+        buildQuadTree();
+        // the calling thread takes ranges too
+        QtConcurrent::blockingMap( ranges, calculateForces );
+        move( temperature );
+        publish();
+        temperature *= m_cooling;
+    }
+}
+
+void ForceLayout::buildQuadTree()
+{
+    float left = m_x.at( 0 );
+    float right = left;
+    float top = m_y.at( 0 );
+    float bottom = top;
+
+    for ( int i = 1; i < m_x.size(); i++ )
+    {
+        left = qMin( left, m_x.at( i ) );
+        right = qMax( right, m_x.at( i ) );
+        top = qMin( top, m_y.at( i ) );
+        bottom = qMax( bottom, m_y.at( i ) );
+    }
+
+    // the arrays keep their capacity from the previous iteration
+    m_cellX.resize( 1 );
+    m_cellY.resize( 1 );
+    m_cellHalf.resize( 1 );
+    m_massX.resize( 1 );
+    m_massY.resize( 1 );
+    m_mass.resize( 1 );
+    m_cellChild.resize( 1 );
+    m_cellBody.resize( 1 );
+
+    m_cellX[0] = ( left + right ) / 2;
+    m_cellY[0] = ( top + bottom ) / 2;
+    m_cellHalf[0] = qMax( qMax( right - left, bottom - top ) / 2, 1.0f );
+    m_massX[0] = m_massY[0] = m_mass[0] = 0;
+    m_cellChild[0] = -1;
+    m_cellBody[0] = -1;
+
+    for ( int i = 0; i < m_x.size(); i++ )
+        insert( i );
+}
+
+// each cell on the way takes the mass of the body, the leaf where it ends
+// is split if it is taken
+void ForceLayout::insert( const int& body )
+{
+    const float x = m_x.at( body );
+    const float y = m_y.at( body );
+    int cell = 0;
+
+    for ( int depth = 0; ; depth++ )
+    {
+        const float mass = m_mass.at( cell );
+        m_massX[cell] = ( m_massX.at( cell ) * mass + x ) / ( mass + 1 );
+        m_massY[cell] = ( m_massY.at( cell ) * mass + y ) / ( mass + 1 );
+        m_mass[cell] = mass + 1;
+
+        if ( m_cellChild.at( cell ) == -1 )
+        {
+            if ( m_cellBody.at( cell ) == -1 )
+            {
+                m_cellBody[cell] = body;
+                return;
+            }
+
+            if ( depth == m_maxDepth )
+            {
+                m_cellBody[cell] = -2;
+                return;
+            }
+
+            // split: the body there goes down to a child
+            const int first = m_cellX.size();
+            const float half = m_cellHalf.at( cell ) / 2;
+
+            for ( int q = 0; q < 4; q++ )
+            {
+                m_cellX.append( m_cellX.at( cell ) + ( q & 1 ? half : -half ) );
+                m_cellY.append( m_cellY.at( cell ) + ( q & 2 ? half : -half ) );
+                m_cellHalf.append( half );
+                m_massX.append( 0 );
+                m_massY.append( 0 );
+                m_mass.append( 0 );
+                m_cellChild.append( -1 );
+                m_cellBody.append( -1 );
+            }
+
+            const int other = m_cellBody.at( cell );
+            const int child = first + ( m_x.at( other ) < m_cellX.at( cell ) ? 0 : 1 ) +
+                              ( m_y.at( other ) < m_cellY.at( cell ) ? 0 : 2 );
+            m_massX[child] = m_x.at( other );
+            m_massY[child] = m_y.at( other );
+            m_mass[child] = 1;
+            m_cellBody[child] = other;
+            m_cellChild[cell] = first;
+            m_cellBody[cell] = -2;
+        }
+
+        cell = m_cellChild.at( cell ) + ( x < m_cellX.at( cell ) ? 0 : 1 ) +
+               ( y < m_cellY.at( cell ) ? 0 : 2 );
+    }
+}
+
+void ForceLayout::calculateForces( Range& range )
+{
+    ForceLayout* layout = range.layout;
+
+    for ( int i = range.begin; i < range.end; i++ )
+    {
+        float fx = 0;
+        float fy = 0;
+        layout->repulse( i, fx, fy );
+        layout->pull( i, fx, fy );
+        layout->m_fx[i] = fx;
+        layout->m_fy[i] = fy;
+    }
+}
+
+// a far enough cell repulses as one body in its center of mass
+void ForceLayout::repulse( const int& body, float& fx, float& fy ) const
+{
+    const float x = m_x.at( body );
+    const float y = m_y.at( body );
+    const float k2 = m_idealLength * m_idealLength;
+    int stack[4 * m_maxDepth + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while ( top )
+    {
+        const int cell = stack[--top];
+
+        if ( m_mass.at( cell ) == 0 || m_cellBody.at( cell ) == body )
+            continue;
+
+        const float dx = x - m_massX.at( cell );
+        const float dy = y - m_massY.at( cell );
+        const float d2 = dx * dx + dy * dy + m_softening;
+        const float size = 2 * m_cellHalf.at( cell );
+
+        if ( m_cellChild.at( cell ) != -1 && size * size >= m_theta * m_theta * d2 )
+        {
+            for ( int q = 0; q < 4; q++ )
+                stack[top++] = m_cellChild.at( cell ) + q;
+
+            continue;
+        }
+
+        // k^2 / d of Fruchterman and Reingold, for each body of the cell
+        const float f = k2 * m_mass.at( cell ) / d2;
+        fx += dx * f;
+        fy += dy * f;
+    }
+}
+
+// springs: rest length keeps the nodes apart by their size
+void ForceLayout::pull( const int& body, float& fx, float& fy ) const
+{
+    for ( int i = 0; i < m_model.degree( body ); i++ )
+    {
+        const int edge = m_model.incidentEdge( body, i );
+        const int other = m_model.otherEnd( edge, body );
+        const float dx = m_x.at( other ) - m_x.at( body );
+        const float dy = m_y.at( other ) - m_y.at( body );
+        const float length = std::sqrt( dx * dx + dy * dy ) + m_softening;
+        const float rest = m_radius.at( body ) + m_radius.at( other ) + m_idealLength / 2;
+        const float f = ( m_model.secondary( edge ) ? m_secondaryStiffness : m_primaryStiffness ) *
+                        ( length - rest ) / length;
+        fx += dx * f;
+        fy += dy * f;
+    }
+}
+
+// one loop over the arrays without branches, vectorised by the compiler
+void ForceLayout::move( const float& temperature )
+{
+    const int count = m_x.size();
+    float* x = m_x.data();
+    float* y = m_y.data();
+    const float* fx = m_fx.constData();
+    const float* fy = m_fy.constData();
+    const float x0 = x[0];
+    const float y0 = y[0];
+
+    for ( int i = 0; i < count; i++ )
+    {
+        const float length = std::sqrt( fx[i] * fx[i] + fy[i] * fy[i] ) + m_softening;
+        const float scale = qMin( temperature, length ) / length;
+        x[i] += fx[i] * scale;
+        y[i] += fy[i] * scale;
+    }
+
+    // the base node stays in place
+    x[0] = x0;
+    y[0] = y0;
+}
+
+void ForceLayout::publish()
+{
+    QMutexLocker locker( &m_mutex );
+    m_positions.resize( m_x.size() );
+
+    for ( int i = 0; i < m_x.size(); i++ )
+        m_positions[i] = QPointF( m_x.at( i ) - m_halfWidth.at( i ),
+                                  m_y.at( i ) - m_halfHeight.at( i ) );
+
+    m_fresh = true;
+}
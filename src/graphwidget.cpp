@@ -4,17 +4,42 @@
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QFileDialog>
-#include <QtXml>
+#include <QtConcurrent>
+#include <QImage>
 #include <QColorDialog>
 #include <QApplication>
+#include <QVarLengthArray>
+#include <QGraphicsRectItem>
+#include <QEventLoop>
 
 #include "include/node.h"
 #include "include/edge.h"
+#include "include/edgelayer.h"
+#include "include/clusterlayer.h"
+#include "include/dragghost.h"
+#include "include/itempool.h"
+#include "include/rendercache.h"
 #include "include/mainwindow.h"
+#include "include/mindmapfile.h"
 
 #include <cmath>
+#include <qmath.h>
 
 const QColor GraphWidget::m_paper( 255, 255, 255 );
+const int GraphWidget::m_journalFlushInterval = 2000;
+const qint64 GraphWidget::m_journalCompactSize = 1 << 20;
+const int GraphWidget::m_edgeBatchThreshold = 2000;
+const QRectF GraphWidget::m_initialSceneRect( -1024, -1024, 2048, 2048 );
+const qreal GraphWidget::m_sceneTile = 1024;
+const qreal GraphWidget::m_exportMargin = 20;
+const qreal GraphWidget::m_clusterZoom = 0.08;
+const int GraphWidget::m_renderCacheBudget = 64 * 1024;
+const int GraphWidget::m_zoomSettleInterval = 200;
+const int GraphWidget::m_forceLayoutInterval = 1000 / 30;
+const qreal GraphWidget::m_insertDistance = 100;
+const qreal GraphWidget::m_insertGap = 10;
+const int GraphWidget::m_insertTries = 512;
+const int GraphWidget::m_ghostDragThreshold = 500;
 
 GraphWidget::GraphWidget( MainWindow* parent )
     : QGraphicsView( parent )
@@ -22,25 +47,75 @@ GraphWidget::GraphWidget( MainWindow* parent )
     , m_activeNode( 0 )
     , m_showingNodeNumbers( false )
     , m_hintNode( 0 )
+    , m_hintDigits( 1 )
+    , m_hintBegin( 0 )
+    , m_hintEnd( 0 )
     , m_editingNode( false )
     , m_edgeAdding( false )
     , m_edgeDeleting( false )
     , m_contentChanged( false )
+    , m_movingNodes( false )
+    , m_dragGroup( 0 )
+    , m_dragGhost( 0 )
+    , m_dragRoot( 0 )
+    , m_layoutStyle( TreeLayout::Manual )
+    , m_batchedEdges( false )
+    , m_clustered( false )
+    , m_zooming( false )
+    , m_writingMapFile( false )
+    , m_changedWhileWriting( false )
 {
     m_scene = new QGraphicsScene( this );
     m_scene->setItemIndexMethod( QGraphicsScene::NoIndex );
-    m_scene->setSceneRect( -1024, -1024, 2048, 2048 );
     setScene( m_scene );
+    m_edgeLayer = new EdgeLayer( this );
+    m_edgeLayer->hide();
+    m_scene->addItem( m_edgeLayer );
+    m_clusterLayer = new ClusterLayer( this );
+    m_clusterLayer->hide();
+    m_scene->addItem( m_clusterLayer );
+    resizeScene( m_initialSceneRect );
     setCacheMode( CacheBackground );
     setViewportUpdateMode( BoundingRectViewportUpdate );
     setRenderHint( QPainter::Antialiasing );
     setTransformationAnchor( AnchorUnderMouse );
+    RenderCache::setBudget( m_renderCacheBudget );
+
+    // renderings of the exact zoom level are made when zooming stops
+    m_zoomTimer = new QTimer( this );
+    m_zoomTimer->setSingleShot( true );
+    m_zoomTimer->setInterval( m_zoomSettleInterval );
+    connect( m_zoomTimer, SIGNAL( timeout() ), this, SLOT( zoomSettled() ) );
+
+    m_forceLayoutTimer = new QTimer( this );
+    m_forceLayoutTimer->setInterval( m_forceLayoutInterval );
+    connect( m_forceLayoutTimer, SIGNAL( timeout() ), this, SLOT( forceLayoutFrame() ) );
+
+    // changes are written to the journal in batches
+    m_journalTimer = new QTimer( this );
+    m_journalTimer->setSingleShot( true );
+    m_journalTimer->setInterval( m_journalFlushInterval );
+    connect( m_journalTimer, SIGNAL( timeout() ), this, SLOT( flushJournal() ) );
+    connect( &m_compaction, SIGNAL( finished() ), this, SLOT( compactionFinished() ) );
+
+    m_writeProgressTimer = new QTimer( this );
+    m_writeProgressTimer->setInterval( 100 );
+    connect( m_writeProgressTimer, SIGNAL( timeout() ), this, SLOT( showWriteProgress() ) );
+    connect( &m_writing, SIGNAL( finished() ), this, SLOT( backgroundWriteFinished() ) );
+}
+
+GraphWidget::~GraphWidget()
+{
+    // the save writes its progress here, whatever path led to the
+    // destruction. MainWindow may be half gone, nothing is reported
+    m_writing.waitForFinished();
+    m_compaction.waitForFinished();
 }
 
 void GraphWidget::nodeSelected( Node* node )
 {
     // leave hint mode
-    showingAllNodeNumbers( false );
+    hideNodeNumbers();
     m_showingNodeNumbers = false;
 
     if ( m_edgeAdding )
@@ -61,200 +136,609 @@ void GraphWidget::nodeSelected( Node* node )
 
 void GraphWidget::nodeMoved( QGraphicsSceneMouseEvent* event )
 {
+    if ( !m_activeNode )
+        return;
+
+    stopForceLayout();
+    const QPointF offset = event->scenePos() - event->lastScenePos();
+
     // move just the active Node, or it's subtree too?
-    QList <Node*> nodeList;
+    if ( !m_dragRoot &&
+         event->modifiers() & Qt::ControlModifier &&
+         event->modifiers() & Qt::ShiftModifier )
+        beginGroupDrag( m_activeNode );
+
+    if ( m_dragRoot )
+        dragGroup( offset );
+    else
+        moveNodes( m_activeNode->id(), false, offset );
+}
 
-    if ( event->modifiers() & Qt::ControlModifier && event->modifiers() & Qt::ShiftModifier )
+void GraphWidget::nodeReleased()
+{
+    endGroupDrag();
+}
+
+bool GraphWidget::movingNodes() const
+{
+    return m_movingNodes;
+}
+
+void GraphWidget::moveNodes( const int& root, const bool& subtree, const QPointF& offset )
+{
+    const int count = subtree ? m_model.subtreeSize( root ) : 1;
+
+    // Nodes don't adjust their edges one by one while moving,
+    // edges inside the subtree would be calculated twice
+    m_movingNodes = true;
+
+    for ( int i = 0; i < count; i++ )
     {
-        nodeList = m_activeNode->subtree();
+        Node* node = m_nodeList.at( m_model.subtreeNode( root, i ) );
+        node->setPos( node->pos() + offset );
     }
-    else
+
+    m_movingNodes = false;
+    adjustEdges( root, subtree );
+    nodesMoved();
+}
+
+void GraphWidget::adjustEdges( const int& root, const bool& subtree )
+{
+    const int count = subtree ? m_model.subtreeSize( root ) : 1;
+
+    // every edge touching the range once: edges inside it from their source
+    for ( int i = 0; i < count; i++ )
     {
-        nodeList.push_back( m_activeNode );
+        const int node = m_model.subtreeNode( root, i );
+
+        for ( int j = 0; j < m_model.degree( node ); j++ )
+        {
+            const int edge = m_model.incidentEdge( node, j );
+            const int other = m_model.otherEnd( edge, node );
+
+            if ( m_model.source( edge ) == node ||
+                 !( subtree && m_model.isAncestor( root, other ) ) )
+                m_edgeList.at( edge )->adjust();
+        }
     }
+}
 
-    foreach ( Node* node, nodeList )
-        node->setPos( node->pos() + event->scenePos() - event->lastScenePos() );
+void GraphWidget::beginGroupDrag( Node* root )
+{
+    m_dragRoot = root;
+
+    // rendered once, the Nodes stay until the drop
+    if ( m_model.subtreeSize( root->id() ) >= m_ghostDragThreshold )
+    {
+        m_dragGhost = new DragGhost( this, root->id(), transform().m11() );
+        m_scene->addItem( m_dragGhost );
+        return;
+    }
+
+    // no contents: only a transformation for the Nodes
+    m_dragGroup = new QGraphicsRectItem();
+    m_dragGroup->setFlag( QGraphicsItem::ItemHasNoContents );
+    m_dragGroup->setZValue( 2 );
+    m_scene->addItem( m_dragGroup );
+    m_dragInnerEdges.clear();
+    m_dragOuterEdges.clear();
+
+    const int id = root->id();
+
+    for ( int i = 0; i < m_model.subtreeSize( id ); i++ )
+    {
+        const int node = m_model.subtreeNode( id, i );
+        m_nodeList.at( node )->setParentItem( m_dragGroup );
+
+        // an inner edge once, from its source
+        for ( int j = 0; j < m_model.degree( node ); j++ )
+        {
+            const int edge = m_model.incidentEdge( node, j );
+
+            if ( !m_model.isAncestor( id, m_model.otherEnd( edge, node ) ) )
+            {
+                m_dragOuterEdges.append( edge );
+            }
+            else if ( m_model.source( edge ) == node )
+            {
+                m_dragInnerEdges.append( edge );
+
+                // drawn by the EdgeLayer otherwise
+                if ( m_edgeList.at( edge )->scene() )
+                    m_edgeList.at( edge )->setParentItem( m_dragGroup );
+            }
+        }
+    }
 }
 
-void GraphWidget::contentChanged( const bool& changed )
+void GraphWidget::dragGroup( const QPointF& offset )
 {
-    m_parent->contentChanged( changed );
+    if ( m_dragGhost )
+    {
+        m_dragGhost->drag( offset );
+        return;
+    }
+
+    m_dragGroup->moveBy( offset.x(), offset.y() );
+
+    foreach ( int edge, m_dragInnerEdges )
+    {
+        if ( m_edgeList.at( edge )->parentItem() != m_dragGroup )
+            m_edgeList.at( edge )->translate( offset );
+    }
+
+    foreach ( int edge, m_dragOuterEdges )
+        m_edgeList.at( edge )->adjust();
 }
 
-void GraphWidget::newScene()
+void GraphWidget::endGroupDrag()
 {
-    removeAllNodes();
-    addFirstNode();
-    this->show();
+    if ( m_dragGhost )
+    {
+        const QPointF offset = m_dragGhost->offset();
+        delete m_dragGhost;
+        m_dragGhost = 0;
+
+        if ( !offset.isNull() )
+            moveNodes( m_dragRoot->id(), true, offset );
+
+        m_dragRoot = 0;
+        return;
+    }
+
+    if ( !m_dragGroup )
+        return;
+
+    const QPointF offset = m_dragGroup->pos();
+    const int id = m_dragRoot->id();
+
+    // back to the scene where they are shown, in one batch
+    m_movingNodes = true;
+
+    for ( int i = 0; i < m_model.subtreeSize( id ); i++ )
+    {
+        Node* node = m_nodeList.at( m_model.subtreeNode( id, i ) );
+        node->setParentItem( 0 );
+        node->setPos( node->pos() + offset );
+    }
+
+    m_movingNodes = false;
+
+    foreach ( int edge, m_dragInnerEdges )
+    {
+        if ( m_edgeList.at( edge )->parentItem() == m_dragGroup )
+        {
+            m_edgeList.at( edge )->setParentItem( 0 );
+            m_edgeList.at( edge )->adjust();
+        }
+    }
+
+    delete m_dragGroup;
+    m_dragGroup = 0;
+    m_dragRoot = 0;
+    m_dragInnerEdges.clear();
+    m_dragOuterEdges.clear();
+
+    if ( !offset.isNull() )
+        nodesMoved();
 }
 
-void GraphWidget::closeScene()
+void GraphWidget::layoutMap( const TreeLayout::Style& style )
 {
-    removeAllNodes();
-    this->hide();
+    nodeLostFocus();
+    stopForceLayout();
+
+    if ( m_nodeList.isEmpty() )
+        return;
+
+    m_layoutStyle = style;
+    relayout( m_nodeList.first() );
 }
 
-bool GraphWidget::readContentFromXmlFile( const QString& fileName )
+void GraphWidget::relayout( Node* root )
 {
-    // open & parse XML file
-    QDomDocument doc( "QtMindMap" );
-    QFile file( fileName );
+    if ( m_layoutStyle == TreeLayout::Manual || !root )
+        return;
+
+    const int id = root->id();
+    const int parent = m_model.parentNode( id );
+    TreeLayout layout( m_model );
 
-    if ( !file.open( QIODevice::ReadOnly ) )
+    if ( parent == -1 )
     {
-        m_parent->statusBarMsg( tr( "Couldn't read file." ) );
-        return false;
+        layout.layoutTree( id, m_layoutStyle );
+    }
+    else
+    {
+        // a subtree grows away from its parent:
+        // to its side, or outwards from the center
+        const QPointF from = m_nodeList.at( parent )->sceneBoundingRect().center();
+        const QPointF to = root->sceneBoundingRect().center();
+        layout.layoutSubtree( id, m_layoutStyle == TreeLayout::Radial ?
+                              atan2( to.y() - from.y(), to.x() - from.x() ) :
+                              to.x() < from.x() ? M_PI : 0 );
     }
 
-    if ( !doc.setContent( &file ) )
+    placeNodes( id, layout );
+}
+
+void GraphWidget::placeNodes( const int& root, const TreeLayout& layout )
+{
+    m_movingNodes = true;
+
+    for ( int i = 0; i < layout.count(); i++ )
     {
-        m_parent->statusBarMsg( tr( "Couldn't parse XML file." ) );
-        file.close();
-        return false;
+        Node* node = m_nodeList.at( m_model.subtreeNode( root, i ) );
+
+        if ( node->pos() != layout.pos( i ) )
+            node->setPos( layout.pos( i ) );
     }
 
-    file.close();
-    QDomElement docElem = doc.documentElement();
-    // add nodes
-    QDomNodeList nodes = docElem.childNodes().item( 0 ).childNodes();
+    m_movingNodes = false;
+    adjustEdges( root, true );
+    nodesMoved();
+}
+
+void GraphWidget::placeAllNodes( const QVector<QPointF>& positions )
+{
+    m_movingNodes = true;
 
-    for (int i = 0; i < nodes.length(); i++ )
+    for ( int i = 0; i < positions.size(); i++ )
     {
-        QDomElement e = nodes.item( i ).toElement();
+        if ( m_nodeList.at( i )->pos() != positions.at( i ) )
+            m_nodeList.at( i )->setPos( positions.at( i ) );
+    }
 
-        if ( !e.isNull() )
-        {
-            Node* node = new Node( this );
-            node->setHtml( e.attribute( "htmlContent" ) );
-            m_scene->addItem( node );
-            node->setPos( e.attribute( "x" ).toFloat(),
-                          e.attribute( "y" ).toFloat() );
-            node->setScale( e.attribute( "scale" ).toFloat(), sceneRect() );
-            node->setColor( QColor( e.attribute( "bg_red" ).toFloat(),
-                                    e.attribute( "bg_green" ).toFloat(),
-                                    e.attribute( "bg_blue" ).toFloat() ) );
-            node->setTextColor( QColor( e.attribute( "text_red" ).toFloat(),
-                                        e.attribute( "text_green" ).toFloat(),
-                                        e.attribute( "text_blue" ).toFloat() ) );
-            m_nodeList.append( node );
-        }
+    m_movingNodes = false;
+
+    foreach ( Edge * edge, m_edgeList )
+        edge->adjust();
+
+    nodesMoved();
+}
+
+void GraphWidget::stopForceLayout()
+{
+    if ( !m_forceLayoutTimer->isActive() )
+        return;
+
+    m_forceLayout.stop();
+    m_forceLayoutTimer->stop();
+}
+
+void GraphWidget::forceLayoutFrame()
+{
+    QVector<QPointF> positions;
+
+    if ( m_forceLayout.takePositions( positions ) &&
+         positions.size() == m_nodeList.size() )
+        placeAllNodes( positions );
+
+    if ( !m_forceLayout.isRunning() && m_forceLayoutTimer->isActive() )
+    {
+        m_forceLayoutTimer->stop();
+        m_parent->statusBarMsg( tr( "Layout finished." ) );
     }
+}
+
+void GraphWidget::nodeChanged( Node* node )
+{
+    // the state of the Node goes to the journal with the next batch
+    if ( m_journal.isOpen() )
+    {
+        m_journalDirty.insert( node );
+        m_journalMoved.remove( node );
 
-    // add edges
-    QDomNodeList edges = docElem.childNodes().item( 1 ).childNodes();
+        if ( !m_journalTimer->isActive() )
+            m_journalTimer->start();
+    }
 
-    for ( int i = 0; i < edges.length(); i++ )
+    contentChanged();
+}
+
+void GraphWidget::nodePositionChanged( Node* node )
+{
+    // a full state in the batch has the position too
+    if ( m_journal.isOpen() && !m_journalDirty.contains( node ) )
+        m_journalMoved.insert( node );
+
+    if ( !m_movingNodes )
+        nodesMoved();
+}
+
+void GraphWidget::nodesMoved()
+{
+    if ( !m_journalMoved.isEmpty() && !m_journalTimer->isActive() )
+        m_journalTimer->start();
+
+    contentChanged();
+}
+
+void GraphWidget::contentChanged( const bool& changed )
+{
+    // the file being written does not have this change
+    if ( changed && !m_writeFileName.isEmpty() )
+        m_changedWhileWriting = true;
+
+    m_parent->contentChanged( changed );
+}
+
+MindMapModel& GraphWidget::model()
+{
+    return m_model;
+}
+
+void GraphWidget::syncModel()
+{
+    // everything else is written to the model right away
+    foreach ( Node* node, m_nodeList )
+        node->syncContent();
+}
+
+Node* GraphWidget::node( const int& id ) const
+{
+    return m_nodeList.at( id );
+}
+
+Edge* GraphWidget::edge( const int& id ) const
+{
+    return m_edgeList.at( id );
+}
+
+void GraphWidget::updateIndex( Node* node )
+{
+    const QRectF rect = node->sceneBoundingRect();
+    m_nodeGrid.update( node->id(), rect );
+    growScene( rect );
+    m_clusterLayer->invalidate();
+}
+
+void GraphWidget::updateIndex( Edge* edge )
+{
+    // Edges are not transformed, their line is in scene coordinates.
+    // The arrow head reaches this far from it
+    m_edgeGrid.update( edge->id(), QLineF( edge->sourcePoint(), edge->destPoint() ),
+                       Edge::arrowSize() + edge->width() );
+}
+
+QList<Node*> GraphWidget::nodesIn( const QRectF& rect ) const
+{
+    QList<Node*> nodes;
+
+    foreach ( int id, m_nodeGrid.query( rect ) )
+        nodes.append( m_nodeList.at( id ) );
+
+    return nodes;
+}
+
+Node* GraphWidget::nodeAt( const QPointF& pos ) const
+{
+    Node* found( 0 );
+
+    // the latest added wins among overlapping ones, as in the scene
+    foreach ( int id, m_nodeGrid.query( QRectF( pos, QSizeF( 0.001, 0.001 ) ) ) )
     {
-        QDomElement e = edges.item( i ).toElement();
+        Node* node = m_nodeList.at( id );
+
+        if ( node->contains( node->mapFromScene( pos ) ) &&
+             ( !found || id > found->id() ) )
+            found = node;
+    }
+
+    return found;
+}
+
+QVector<int> GraphWidget::edgesIn( const QRectF& rect ) const
+{
+    return m_edgeGrid.query( rect );
+}
+
+EdgeLayer* GraphWidget::edgeLayer() const
+{
+    return m_edgeLayer;
+}
+
+void GraphWidget::setBatchedEdges( const bool& batched )
+{
+    if ( batched == m_batchedEdges )
+        return;
 
-        if ( !e.isNull() )
+    m_batchedEdges = batched;
+
+    foreach ( Edge* edge, m_edgeList )
+    {
+        if ( batched )
+        {
+            m_scene->removeItem( edge );
+        }
+        else
         {
-            Edge* edge = new Edge(
-                m_nodeList[e.attribute( "source" ).toInt()],
-                m_nodeList[e.attribute( "destination" ).toInt()] );
-            edge->setColor( QColor( e.attribute( "red" ).toFloat(),
-                                    e.attribute( "green" ).toFloat(),
-                                    e.attribute( "blue" ).toFloat() ) );
-            edge->setWidth( e.attribute( "width" ).toFloat() );
-            edge->setSecondary( e.attribute( "secondary" ).toInt() );
             m_scene->addItem( edge );
+            edge->setVisible( !m_clustered );
         }
     }
 
-    // test the first node the active one
-    m_activeNode = m_nodeList.first();
-    m_activeNode->setBorder();
-    m_activeNode->setFocus();
-    this->show();
-    return true;
+    m_edgeLayer->setVisible( batched && !m_clustered );
+    m_edgeLayer->update();
 }
 
-void GraphWidget::writeContentToXmlFile( const QString& fileName )
+bool GraphWidget::batchedEdges() const
 {
-    // create XML doc object
-    QDomDocument doc( "QtMindMap" );
-    QDomElement root = doc.createElement( "qtmindmap" );
-    doc.appendChild( root );
-    // nodes
-    QDomElement nodes_root = doc.createElement( "nodes" );
-    root.appendChild( nodes_root );
+    return m_batchedEdges;
+}
+
+bool GraphWidget::zooming() const
+{
+    return m_zooming;
+}
+
+void GraphWidget::zoomSettled()
+{
+    m_zooming = false;
+    viewport()->update();
+}
+
+void GraphWidget::setClustered( const bool& clustered )
+{
+    if ( clustered == m_clustered )
+        return;
+
+    m_clustered = clustered;
 
     foreach ( Node* node, m_nodeList )
+        node->setVisible( !clustered );
+
+    if ( m_batchedEdges )
     {
-        QDomElement cn = doc.createElement( "node" );
-        // no need to store ID: parsing order is preorder.
-        // cn.setAttribute( "id", QString::number(m_nodeList.indexOf(node)));
-        cn.setAttribute( "x", QString::number( node->pos().x() ) );
-        cn.setAttribute( "y", QString::number( node->pos().y() ) );
-        cn.setAttribute( "htmlContent", node->toHtml() );
-        cn.setAttribute( "scale", QString::number( node->scale() ) );
-        cn.setAttribute( "bg_red", QString::number( node->color().red() ) );
-        cn.setAttribute( "bg_green", QString::number( node->color().green() ) );
-        cn.setAttribute( "bg_blue", QString::number( node->color().blue() ) );
-        cn.setAttribute( "text_red", QString::number( node->textColor().red() ) );
-        cn.setAttribute( "text_green",
-                         QString::number( node->textColor().green() ) );
-        cn.setAttribute( "text_blue",
-                         QString::number( node->textColor().blue() ) );
-        nodes_root.appendChild( cn );
+        m_edgeLayer->setVisible( !clustered );
     }
-
-    //edges
-    QDomElement edges_root = doc.createElement( "edges" );
-    root.appendChild( edges_root );
-
-    foreach ( Edge* edge, allEdges() )
+    else
     {
-        QDomElement cn = doc.createElement( "edge" );
-        cn.setAttribute( "source",
-                         QString::number( m_nodeList.indexOf( edge->sourceNode() ) ) );
-        cn.setAttribute( "destination",
-                         QString::number( m_nodeList.indexOf( edge->destNode() ) ) );
-        cn.setAttribute( "red", QString::number( edge->color().red() ) );
-        cn.setAttribute( "green", QString::number( edge->color().green() ) );
-        cn.setAttribute( "blue", QString::number( edge->color().blue() ) );
-        cn.setAttribute( "width", QString::number( edge->width() ) );
-        cn.setAttribute( "secondary", QString::number( edge->secondary() ) );
-        edges_root.appendChild( cn );
+        foreach ( Edge* edge, m_edgeList )
+            edge->setVisible( !clustered );
     }
 
-    // write XML doc object to file
-    QFile file( fileName );
+    m_clusterLayer->setVisible( clustered );
+    m_clusterLayer->invalidate();
+}
+
+void GraphWidget::newScene()
+{
+    waitForBackgroundWrite();
+    closeJournal();
+    removeAllNodes();
+    addFirstNode();
+    this->show();
+}
+
+void GraphWidget::closeScene()
+{
+    waitForBackgroundWrite();
+    closeJournal();
+    removeAllNodes();
+    this->hide();
+}
+
+bool GraphWidget::readContentFromFile( const QString& fileName )
+{
+    removeAllNodes();
+    QString error;
 
-    if ( !file.open( QIODevice::WriteOnly ) )
+    // parsing needs no scene, the views are created for the result
+    if ( !MindMapFile::read( fileName, m_model, &error ) )
     {
-        m_parent->statusBarMsg( tr( "Couldn't open file to write." ) );
-        return;
+        m_parent->statusBarMsg( error );
+        return false;
     }
 
-    QTextStream ts( &file );
-    ts << doc.toString();
-    file.close();
-    // show a statusBar message to the user
-    m_parent->statusBarMsg( tr( "Saved." ) );
+    buildScene();
+
+    // test the first node the active one
+    m_activeNode = m_nodeList.first();
+    m_activeNode->setBorder();
+    m_activeNode->setFocus();
+    this->show();
+    return true;
+}
+
+void GraphWidget::writeContentToFile( const QString& fileName )
+{
+    waitForBackgroundWrite();
+    // journal of the previous file is closed, the new one is started when
+    // the file is written
+    closeJournal();
+    startBackgroundWrite( QtConcurrent::run( MindMapFile::write, snapshot(),
+                          fileName, &m_writeProgress ),
+                          fileName, tr( "Saved." ), true );
+}
+
+// QImage can be saved on any thread
+static bool writeImage( const QImage& image, const QString& fileName )
+{
+    return image.save( fileName );
 }
 
 void GraphWidget::writeContentToPngFile( const QString& fileName )
 {
-    QImage img( m_scene->sceneRect().width(),
-                m_scene->sceneRect().height(),
+    waitForBackgroundWrite();
+    // rendering needs the scene, it stays on this thread,
+    // encoding and writing goes to a worker
+    // the occupied part of the canvas, not the whole scene
+    const QRectF source = m_nodeGrid.bounds().united( m_edgeGrid.bounds() ).
+                          adjusted( -m_exportMargin, -m_exportMargin,
+                                    m_exportMargin, m_exportMargin );
+    QImage img( qCeil( source.width() ),
+                qCeil( source.height() ),
                 QImage::Format_ARGB32_Premultiplied );
     QPainter painter( &img );
     painter.setRenderHint( QPainter::Antialiasing );
+    // the map itself in full detail, whatever the view shows now: no cluster
+    // glyphs and no pixmaps of a near zoom level scaled
+    const bool clustered = m_clustered;
+    const bool zooming = m_zooming;
+    setClustered( false );
+    m_zooming = false;
     // Strange that I have to set this, and scene->render() does not do this
     m_scene->setBackgroundBrush( GraphWidget::m_paper );
-    m_scene->render( &painter );
+    m_scene->render( &painter, QRectF(), source );
     painter.setBackground( GraphWidget::m_paper );
     painter.end();
-    img.save( fileName );
-    // show a statusBar message to the user
-    m_parent->statusBarMsg( tr( "MindMap exported as " ) + fileName );
+    m_zooming = zooming;
+    setClustered( clustered );
+    startBackgroundWrite( QtConcurrent::run( writeImage, img, fileName ),
+                          fileName, tr( "MindMap exported as " ) + fileName, false );
+}
+
+MindMapModel GraphWidget::snapshot()
+{
+    syncModel();
+    return m_model;
+}
+
+bool GraphWidget::openJournal( const QString& fileName, const bool& recover )
+{
+    closeJournal();
+    bool unsaved( false );
+    QList<QByteArray> records;
+
+    if ( recover )
+    {
+        records = Journal::recover( fileName, unsaved );
+        replayJournal( records );
+    }
+
+    // the replayed records are kept, they are not in the file yet
+    if ( !m_journal.open( fileName, records ) )
+    {
+        m_parent->statusBarMsg( tr( "Couldn't open journal, saving the whole file." ) );
+        return unsaved;
+    }
+
+    return m_journal.hasUnsaved();
+}
+
+bool GraphWidget::saveJournal( const QString& fileName )
+{
+    if ( !m_journal.isOpen() || m_journal.mapFileName() != fileName )
+        return false;
+
+    m_journalTimer->stop();
+    flushJournal();
+    m_journal.checkpoint();
+
+    // once the journal has grown, rewrite the file in the background
+    if ( m_journal.size() > m_journalCompactSize )
+        compactJournal();
+
+    m_parent->statusBarMsg( tr( "Saved." ) );
+    return true;
 }
 
 void GraphWidget::insertNode()
 {
     nodeLostFocus();
+    stopForceLayout();
 
     if ( !m_activeNode )
     {
@@ -262,34 +746,18 @@ void GraphWidget::insertNode()
         return;
     }
 
-    // get the biggest angle between the edges of the Node.
-    double angle( m_activeNode->calculateBiggestAngle() );
-    // let the distance between the current and new Node be 100 pixels
-    qreal length( 100 );
-    QPointF pos( length * cos( angle ), length * sin( angle ) );
     // add a new node which inherits the color and textColor
-    Node* node = new Node( this );
+    Node* node = createNodeView( m_model.addNode() );
     node->setColor( m_activeNode->color() );
     node->setTextColor( m_activeNode->textColor() );
-    node->setHtml( QString( "" ) );
-    m_scene->addItem( node );
-    QPointF newPos( m_activeNode->sceneBoundingRect().center() +
-                    pos -
-                    node->boundingRect().center() );
-    QRectF rect ( scene()->sceneRect().topLeft(),
-                  scene()->sceneRect().bottomRight() -
-                  node->boundingRect().bottomRight() );
-
-    if ( !rect.contains( newPos ) )
-    {
-        delete node;
-        m_parent->statusBarMsg( tr( "New node would be placed outside of the scene" ) );
-        return;
-    }
-
-    node->setPos( newPos );
-    m_nodeList.append( node );
+    // the free place nearest to the biggest angle between the edges
+    // of the Node. The scene grows to make room for it
+    node->setPos( freePlace( node, m_activeNode->calculateBiggestAngle() ) -
+                  node->boundingRect().center() );
+    journalNode( Journal::NodeAdded, node );
     addEdge( m_activeNode, node );
+    // with a layout its siblings make room for it
+    relayout( m_activeNode );
     // set it the active Node and editable, so the user can edit it at once
     setActiveNode( node );
     editNode();
@@ -297,11 +765,60 @@ void GraphWidget::insertNode()
 
     // it we are in hint mode, the numbers shall be re-calculated
     if ( m_showingNodeNumbers )
+    {
+        hideNodeNumbers();
         showNodeNumbers();
+    }
+}
+
+QPointF GraphWidget::freePlace( Node* node, const double& angle ) const
+{
+    const QPointF center = m_activeNode->sceneBoundingRect().center();
+    const QSizeF size = node->boundingRect().size() +
+                        QSizeF( 2 * m_insertGap, 2 * m_insertGap );
+    const qreal step = qMax( size.width(), size.height() ) / 2;
+    int tries = 0;
+
+    // rings outwards, on a ring turning away from the angle both ways,
+    // in steps of about the height of the Node
+    for ( qreal radius = m_insertDistance; tries < m_insertTries; radius += step )
+    {
+        const double turn = size.height() / radius;
+
+        for ( int i = 0; i * turn <= M_PI && tries < m_insertTries; i++ )
+        {
+            for ( int side = i ? -1 : 1; side <= 1 && tries < m_insertTries; side += 2 )
+            {
+                tries++;
+                const double a = angle + side * i * turn;
+                const QPointF pos = center + QPointF( radius * cos( a ), radius * sin( a ) );
+                const QRectF rect( pos - QPointF( size.width() / 2, size.height() / 2 ), size );
+                bool free = true;
+
+                foreach ( int id, m_nodeGrid.query( rect ) )
+                {
+                    if ( id != node->id() )
+                    {
+                        free = false;
+                        break;
+                    }
+                }
+
+                if ( free )
+                    return pos;
+            }
+        }
+    }
+
+    // crowded everywhere: where it was put before
+    return center + QPointF( m_insertDistance * cos( angle ), m_insertDistance * sin( angle ) );
 }
 
 void GraphWidget::removeNode()
 {
+    // the dragged subtree might be removed
+    endGroupDrag();
+
     if ( !m_activeNode )
     {
         m_parent->statusBarMsg( tr( "No active node." ) );
@@ -314,6 +831,12 @@ void GraphWidget::removeNode()
         return;
     }
 
+    stopForceLayout();
+
+    // its siblings close up with a layout
+    const int parentId = m_model.parentNode( m_activeNode->id() );
+    Node* parent = parentId == -1 ? 0 : m_nodeList.at( parentId );
+
     // remove just the active Node or it's subtree too?
     QList <Node*> nodeList;
 
@@ -327,16 +850,27 @@ void GraphWidget::removeNode()
         nodeList.push_back( m_activeNode );
     }
 
+    // numbered again without them
+    hideNodeNumbers();
+
     foreach ( Node* node, nodeList )
     {
-        if ( m_hintNode == node )
-            m_hintNode = 0;
+        if ( m_journal.isOpen() )
+        {
+            QByteArray record;
+            QDataStream out( &record, QIODevice::WriteOnly );
+            out.setVersion( QDataStream::Qt_5_0 );
+            out << quint8( Journal::NodeRemoved ) << qint32( node->id() );
+            journalRecord( record );
+            m_journalDirty.remove( node );
+            m_journalMoved.remove( node );
+        }
 
-        m_nodeList.removeAll( node );
-        delete node;
+        deleteNode( node );
     }
 
     m_activeNode = 0;
+    relayout( parent );
     contentChanged();
 
     // it we are in hint mode, the numbers shall be re-calculated
@@ -381,11 +915,15 @@ void GraphWidget::scaleUp()
         QList <Node*> nodeList = m_activeNode->subtree();
 
         foreach ( Node* node, nodeList )
-            node->setScale( qreal( 1.2 ), sceneRect() );
+        {
+            node->setScale( qreal( 1.2 ) );
+            nodeChanged( node );
+        }
     }
     else
     {
-        m_activeNode->setScale( qreal( 1.2 ), sceneRect() );
+        m_activeNode->setScale( qreal( 1.2 ) );
+        nodeChanged( m_activeNode );
     }
 }
 
@@ -403,11 +941,15 @@ void GraphWidget::scaleDown()
         QList <Node*> nodeList = m_activeNode->subtree();
 
         foreach ( Node* node, nodeList )
-            node->setScale( qreal( 1 / 1.2 ), sceneRect() );
+        {
+            node->setScale( qreal( 1 / 1.2 ) );
+            nodeChanged( node );
+        }
     }
     else
     {
-        m_activeNode->setScale( qreal( 1 / 1.2 ), sceneRect() );
+        m_activeNode->setScale( qreal( 1 / 1.2 ) );
+        nodeChanged( m_activeNode );
     }
 }
 
@@ -446,8 +988,15 @@ void GraphWidget::nodeColor()
     {
         node->setColor( color );
 
-        foreach ( Edge* edge, node->edgesToThis( false ) )
-            edge->setColor( color );
+        for ( int i = 0; i < m_model.degree( node->id() ); i++ )
+        {
+            const int edge = m_model.incidentEdge( node->id(), i );
+
+            if ( m_model.destination( edge ) == node->id() )
+                m_edgeList.at( edge )->setColor( color );
+        }
+
+        nodeChanged( node );
     }
 }
 
@@ -483,7 +1032,10 @@ void GraphWidget::nodeTextColor()
     QColor color = dialog.selectedColor();
 
     foreach ( Node* node, nodeList )
+    {
         node->setTextColor( color );
+        nodeChanged( node );
+    }
 }
 
 void GraphWidget::addEdge()
@@ -508,6 +1060,10 @@ void GraphWidget::nodeLostFocus()
         {
             m_activeNode->setEditable( false );
             m_activeNode->update();
+
+            // the edited Node may have grown
+            const int parent = m_model.parentNode( m_activeNode->id() );
+            relayout( parent == -1 ? m_activeNode : m_nodeList.at( parent ) );
         }
 
         return;
@@ -530,7 +1086,7 @@ void GraphWidget::nodeLostFocus()
     if ( m_showingNodeNumbers )
     {
         m_hintNumber.clear();
-        showingAllNodeNumbers( false );
+        hideNodeNumbers();
         m_showingNodeNumbers = false;
         return;
     }
@@ -544,15 +1100,47 @@ void GraphWidget::hintMode()
 
     if ( !m_showingNodeNumbers )
     {
-        showingAllNodeNumbers( false );
+        hideNodeNumbers();
+        return;
+    }
+
+    m_hintNumber.clear();
+    showNodeNumbers();
+}
+
+
+void GraphWidget::treeLayout()
+{
+    layoutMap( TreeLayout::LeftRight );
+}
+
+void GraphWidget::radialLayout()
+{
+    layoutMap( TreeLayout::Radial );
+}
+
+void GraphWidget::forceLayout()
+{
+    nodeLostFocus();
+
+    if ( m_forceLayoutTimer->isActive() )
+    {
+        stopForceLayout();
+        // where it got to
+        forceLayoutFrame();
+        m_parent->statusBarMsg( tr( "Layout stopped." ) );
+        return;
+    }
+
+    if ( m_nodeList.isEmpty() )
         return;
-    }
 
-    m_hintNumber.clear();
-    showNodeNumbers();
+    // it would fight with the tree layout
+    m_layoutStyle = TreeLayout::Manual;
+    m_forceLayout.start( snapshot() );
+    m_forceLayoutTimer->start();
 }
 
-
 void GraphWidget::insertPicture( const QString& picture )
 {
     if ( !m_activeNode )
@@ -598,20 +1186,19 @@ void GraphWidget::keyPressEvent( QKeyEvent* event )
 
             if ( event->modifiers() &  Qt::ControlModifier )
             {
+                stopForceLayout();
+
                 // Move whole subtree of active Node.
                 if ( event->modifiers() &  Qt::ShiftModifier )
                 {
-                    QList <Node*> nodeList = m_activeNode->subtree();
+                    QPointF offset;
 
-                    foreach ( Node* node, nodeList )
-                    {
-                        if ( event->key() == Qt::Key_Up ) node->moveBy( 0, -20 );
-                        else if ( event->key() == Qt::Key_Down ) node->moveBy( 0, 20 );
-                        else if ( event->key() == Qt::Key_Left ) node->moveBy( -20, 0 );
-                        else if ( event->key() == Qt::Key_Right ) node->moveBy( 20, 0 );
+                    if ( event->key() == Qt::Key_Up ) offset = QPointF( 0, -20 );
+                    else if ( event->key() == Qt::Key_Down ) offset = QPointF( 0, 20 );
+                    else if ( event->key() == Qt::Key_Left ) offset = QPointF( -20, 0 );
+                    else if ( event->key() == Qt::Key_Right ) offset = QPointF( 20, 0 );
 
-                        contentChanged();
-                    }
+                    moveNodes( m_activeNode->id(), true, offset );
                 }
                 else // Move just the active Node.
                 {
@@ -670,8 +1257,7 @@ void GraphWidget::keyPressEvent( QKeyEvent* event )
                 break;
 
             m_hintNumber.append( QString::number( event->key() - 48 ) );
-            showingAllNodeNumbers( false );
-            showingNodeNumbersBeginWithNumber( m_hintNumber.toInt(), true );
+            showNodeNumbers();
             break;
 
         // Delete one letter back in hint mode.
@@ -715,6 +1301,18 @@ void GraphWidget::keyPressEvent( QKeyEvent* event )
             nodeTextColor();
             break;
 
+        case Qt::Key_L:
+            treeLayout();
+            break;
+
+        case Qt::Key_R:
+            radialLayout();
+            break;
+
+        case Qt::Key_G:
+            forceLayout();
+            break;
+
         default:
             QGraphicsView::keyPressEvent( event );
     }
@@ -733,10 +1331,32 @@ void GraphWidget::wheelEvent( QWheelEvent* event )
 
 void GraphWidget::drawBackground( QPainter* painter, const QRectF& rect )
 {
-    Q_UNUSED( rect );
-    painter->fillRect( m_scene->sceneRect(), GraphWidget::m_paper );
-    painter->setBrush( Qt::NoBrush );
-    painter->drawRect( m_scene->sceneRect() );
+    // the canvas has no edge, paper wherever it is shown
+    painter->fillRect( rect, GraphWidget::m_paper );
+}
+
+void GraphWidget::resizeScene( const QRectF& rect )
+{
+    m_scene->setSceneRect( rect );
+    m_edgeLayer->setRect( rect );
+    m_clusterLayer->setRect( rect );
+}
+
+void GraphWidget::growScene( const QRectF& rect )
+{
+    const QRectF needed = rect.adjusted( -m_sceneTile / 2, -m_sceneTile / 2,
+                                         m_sceneTile / 2, m_sceneTile / 2 );
+
+    if ( m_scene->sceneRect().contains( needed ) )
+        return;
+
+    // by whole tiles, not at every step of a drag
+    const QRectF united = m_scene->sceneRect().united( needed );
+    const QPointF topLeft( qFloor( united.left() / m_sceneTile ) * m_sceneTile,
+                           qFloor( united.top() / m_sceneTile ) * m_sceneTile );
+    const QPointF bottomRight( qCeil( united.right() / m_sceneTile ) * m_sceneTile,
+                               qCeil( united.bottom() / m_sceneTile ) * m_sceneTile );
+    resizeScene( QRectF( topLeft, bottomRight ) );
 }
 
 void GraphWidget::scaleView( qreal scaleFactor )
@@ -744,29 +1364,22 @@ void GraphWidget::scaleView( qreal scaleFactor )
     qreal factor = transform().scale( scaleFactor, scaleFactor ).
                    mapRect( QRectF( 0, 0, 1, 1 ) ).width();
 
-    // don't allow to scale up/down too much
-    if ( factor < 0.2 || factor > 10 )
+    // don't allow to scale up/down too much,
+    // far enough to see a big map as clusters
+    if ( factor < 0.02 || factor > 10 )
         return;
 
+    m_zooming = true;
+    m_zoomTimer->start();
     scale( scaleFactor, scaleFactor );
+    setClustered( factor < m_clusterZoom );
 }
 
 QList<Edge*> GraphWidget::allEdges() const
 {
-    QList<Edge*> list;
-
-    // GraphWidget has a list of Nodes only.
-    // Each Node maintains a list of it's own Edges.
-    // We iterate through the list of Nodes and call Node::edgesFrom() on them.
-    // edgesFrom(exludeSecundaries=false) return a list of edges (including
-    // secondary edges) which starts from this Node.
-    foreach ( Node* node, m_nodeList )
-        list.append( node->edgesFrom( false ) );
-
-    return list;
+    return m_edgeList;
 }
 
-
 void GraphWidget::addEdge( Node* source, Node* destination )
 {
     if ( !m_activeNode )
@@ -789,23 +1402,17 @@ void GraphWidget::addEdge( Node* source, Node* destination )
     }
     else
     {
-        // aviod the graph beeing acyclic. (ok, Nodes having multiple parents)
-        bool sec( false );
+        Edge* edge = createEdge( source, destination );
+        edge->setColor( destination->color() );
+        edge->setWidth( destination->scale() * 2 + 1 );
 
-        if ( !destination->edgesToThis().empty() )
-        {
+        // The model adds the Edge as secondary if the Node already has a
+        // parent or the Edge would close a cycle
+        if ( edge->secondary() )
             m_parent->statusBarMsg(
                 tr( "The graph is acyclic, edge added as secondary edge." ) );
-            sec = true;
-        }
 
-        Edge* edge = new Edge( source, destination );
-        edge->setColor( destination->color() );
-        edge->setWidth( destination->scale() * 2 + 1 );
-        // The Edge is secondary, because the Node already has a parent
-        // (it is already a destination of another Edge)
-        edge->setSecondary( sec );
-        m_scene->addItem( edge );
+        journalEdge( Journal::EdgeAdded, source, destination, edge );
         contentChanged();
     }
 }
@@ -824,30 +1431,92 @@ void GraphWidget::removeEdge( Node* source, Node* destination )
     }
     else
     {
-        source->deleteEdge( destination );
+        journalEdge( Journal::EdgeRemoved, source, destination );
+        deleteEdge( source->edgeTo( destination ) );
         contentChanged();
     }
 }
 
+Edge* GraphWidget::createEdge( Node* source, Node* destination )
+{
+    Edge* edge = new Edge( this, source, destination,
+                           m_model.addEdge( source->id(), destination->id() ) );
+
+    if ( !m_batchedEdges )
+    {
+        m_scene->addItem( edge );
+        edge->setVisible( !m_clustered );
+    }
+
+    m_edgeList.append( edge );
+    // the primary tree may have changed
+    m_clusterLayer->invalidate();
+    return edge;
+}
+
+void GraphWidget::deleteEdge( Edge* edge )
+{
+    const int id = edge->id();
+    const int moved = m_model.removeEdge( id );
+    m_edgeGrid.remove( id );
+
+    // the last edge took the place of the removed one
+    if ( moved != -1 )
+    {
+        m_edgeList[id] = m_edgeList.at( moved );
+        m_edgeList[id]->setId( id );
+    }
+
+    m_edgeList.removeLast();
+
+    if ( m_batchedEdges )
+        m_edgeLayer->edgeChanged( edge->boundingRect() );
+
+    m_clusterLayer->invalidate();
+    delete edge;
+}
+
 void GraphWidget::addFirstNode()
 {
-    Node* node = new Node( this );
-    node->setHtml(
-        QString( "<img src=:/qtmindmap.svg width=50 height=50></img>" ) );
-    m_scene->addItem( node );
-    m_nodeList.append( node );
-    m_activeNode = m_nodeList.first();
+    const int id = m_model.addNode();
+    m_model.setContent( id, QByteArray(
+                            "<img src=:/qtmindmap.svg width=50 height=50></img>" ) );
+    m_activeNode = createNodeView( id );
     m_activeNode->setBorder();
 }
 
 void GraphWidget::removeAllNodes()
 {
-    foreach ( Node* node, m_nodeList )
-        delete node;
+    endGroupDrag();
+    stopForceLayout();
+    hideNodeNumbers();
+
+    // backwards: the scene removes its last top-level items cheaply,
+    // removing from the front would shift all the others every time
+    for ( int i = m_edgeList.size() - 1; i >= 0; i-- )
+        delete m_edgeList.at( i );
 
+    for ( int i = m_nodeList.size() - 1; i >= 0; i-- )
+        delete m_nodeList.at( i );
+
+    // the memory of the views goes back in a few chunks
+    ItemPool<Edge>::clear();
+    ItemPool<Node>::clear();
+
+    m_edgeList.clear();
     m_nodeList.clear();
+    m_edgeGrid.clear();
+    m_nodeGrid.clear();
+    setBatchedEdges( false );
+    // grows again with the Nodes of the next map
+    resizeScene( m_initialSceneRect );
     m_activeNode = 0;
     m_hintNode = 0;
+    m_layoutStyle = TreeLayout::Manual;
+
+    // the mapped file of a binary map is released with the last
+    // snapshot refering to it
+    m_model.clear();
 }
 
 void GraphWidget::setActiveNode( Node* node )
@@ -859,70 +1528,558 @@ void GraphWidget::setActiveNode( Node* node )
     m_activeNode->setBorder();
 }
 
-// re-draw numbers
-void GraphWidget::showNodeNumbers()
+Node* GraphWidget::createNodeView( const int& id )
+{
+    Node* node = new Node( this, id );
+    node->setVisible( !m_clustered );
+    m_scene->addItem( node );
+    m_nodeList.append( node );
+    node->loadFromModel();
+    return node;
+}
+
+void GraphWidget::deleteNode( Node* node )
+{
+    while ( m_model.degree( node->id() ) > 0 )
+        deleteEdge( m_edgeList.at( m_model.incidentEdge( node->id(), 0 ) ) );
+
+    const int id = node->id();
+    const int moved = m_model.removeNode( id );
+    m_nodeGrid.remove( id );
+
+    // the last node took the place of the removed one
+    if ( moved != -1 )
+    {
+        m_nodeList[id] = m_nodeList.at( moved );
+        m_nodeList[id]->setId( id );
+    }
+
+    m_nodeList.removeLast();
+    m_clusterLayer->invalidate();
+    delete node;
+}
+
+void GraphWidget::buildScene()
+{
+    // big maps draw their edges in batches
+    setBatchedEdges( m_model.edgeCount() >= m_edgeBatchThreshold );
+
+    for ( int i = 0; i < m_model.nodeCount(); i++ )
+    {
+        Node* node = new Node( this, i );
+        node->setVisible( !m_clustered );
+        m_scene->addItem( node );
+        m_nodeList.append( node );
+    }
+
+    for ( int i = 0; i < m_model.edgeCount(); i++ )
+    {
+        Edge* edge = new Edge( this, m_nodeList.at( m_model.source( i ) ),
+                               m_nodeList.at( m_model.destination( i ) ), i );
+
+        if ( !m_batchedEdges )
+        {
+            m_scene->addItem( edge );
+            edge->setVisible( !m_clustered );
+        }
+
+        m_edgeList.append( edge );
+    }
+
+    // Edges are there already, positioning the Nodes adjusts them
+    foreach ( Node* node, m_nodeList )
+        node->loadFromModel();
+}
+
+void GraphWidget::flushJournal()
+{
+    if ( !m_journal.isOpen() )
+        return;
+
+    if ( !m_journalDirty.isEmpty() )
+    {
+        foreach ( Node* node, m_journalDirty )
+            journalNode( Journal::NodeState, node );
+
+        m_journalDirty.clear();
+    }
+
+    // a running force layout moves every Node, the content stays out
+    if ( !m_journalMoved.isEmpty() )
+    {
+        foreach ( Node* node, m_journalMoved )
+        {
+            QByteArray record;
+            QDataStream out( &record, QIODevice::WriteOnly );
+            out.setVersion( QDataStream::Qt_5_0 );
+            out << quint8( Journal::NodePosition ) << qint32( node->id() ) << node->pos();
+            m_journal.append( record );
+        }
+
+        m_journalMoved.clear();
+    }
+
+    if ( !m_journal.flush() )
+        m_parent->statusBarMsg( tr( "Couldn't write journal." ) );
+}
+
+void GraphWidget::compactionFinished()
+{
+    // closeJournal might have waited for it already
+    if ( !m_journal.isCompacting() )
+        return;
+
+    const bool committed = m_compaction.result();
+    m_journal.endCompaction( committed );
+
+    if ( !committed )
+        m_parent->statusBarMsg( tr( "Couldn't write file." ) );
+}
+
+void GraphWidget::backgroundWriteFinished()
+{
+    // waitForBackgroundWrite might have handled it already
+    if ( m_writeFileName.isEmpty() )
+        return;
+
+    const QString fileName = m_writeFileName;
+    m_writeFileName.clear();
+    m_writeProgressTimer->stop();
+    m_parent->statusBarProgress( -1 );
+
+    if ( !m_writing.result() )
+    {
+        m_parent->statusBarMsg( tr( "Couldn't write file." ) );
+
+        // the map is not saved after all
+        if ( m_writingMapFile )
+            contentChanged();
+
+        return;
+    }
+
+    // changes made meanwhile are neither in the file nor in a journal,
+    // the next save writes the whole file again
+    if ( m_writingMapFile && !m_changedWhileWriting )
+    {
+        openJournal( fileName, false );
+        contentChanged( false );
+    }
+
+    m_parent->statusBarMsg( m_writeMessage );
+}
+
+void GraphWidget::showWriteProgress()
+{
+    m_parent->statusBarProgress( m_writeProgress.load() );
+}
+
+void GraphWidget::startBackgroundWrite( const QFuture<bool>& future,
+                                        const QString& fileName,
+                                        const QString& message,
+                                        const bool& mapFile )
 {
-    if ( m_hintNumber.isEmpty() )
+    m_writeFileName = fileName;
+    m_writeMessage = message;
+    m_writingMapFile = mapFile;
+    m_changedWhileWriting = false;
+    m_writeProgress.store( 0 );
+    m_writing.setFuture( future );
+
+    // map files report their progress, an image is encoded in one call
+    if ( mapFile )
     {
-        showingAllNodeNumbers( true );
-        m_nodeList.first()->showNumber( 0, true, true );
-        m_hintNode = m_nodeList.first();
+        m_writeProgressTimer->start();
+        m_parent->statusBarProgress( 0 );
     }
     else
     {
-        showingAllNodeNumbers( false );
-        showingNodeNumbersBeginWithNumber( m_hintNumber.toInt(), true );
+        m_parent->statusBarBusy();
     }
+
+    m_parent->statusBarMsg( tr( "Writing " ) + fileName );
+}
+
+void GraphWidget::waitForBackgroundWrite()
+{
+    if ( m_writeFileName.isEmpty() )
+        return;
+
+    m_writing.waitForFinished();
+    backgroundWriteFinished();
 }
 
-// show/hide numbers on all nodes
-void GraphWidget::showingAllNodeNumbers( const bool& show )
+void GraphWidget::journalNode( const Journal::RecordType& type, Node* node )
 {
-    int i( 0 );
+    if ( !m_journal.isOpen() )
+        return;
 
-    for ( QList<Node*>::const_iterator it = m_nodeList.begin();
-          it != m_nodeList.end(); it++,
-          i++ )
+    node->syncContent();
+    QByteArray record;
+    QDataStream out( &record, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_5_0 );
+    out << quint8( type ) << qint32( node->id() ) << node->pos() << node->scale()
+        << node->color() << node->textColor() << m_model.html( node->id() );
+
+    // color and width of the edges to the Node follow the Node
+    QVarLengthArray<Edge*, 8> edges;
+
+    for ( int i = 0; i < m_model.degree( node->id() ); i++ )
     {
-        dynamic_cast<Node*>( *it )->showNumber( i, show );
+        const int edge = m_model.incidentEdge( node->id(), i );
+
+        if ( m_model.destination( edge ) == node->id() )
+            edges.append( m_edgeList.at( edge ) );
     }
+
+    out << qint32( edges.size() );
+
+    for ( int i = 0; i < edges.size(); i++ )
+        out << qint32( edges.at( i )->sourceNode()->id() )
+            << edges.at( i )->color() << edges.at( i )->width()
+            << edges.at( i )->secondary();
+
+    journalRecord( record );
+}
+
+void GraphWidget::journalEdge( const Journal::RecordType& type, Node* source,
+                               Node* destination, Edge* edge )
+{
+    if ( !m_journal.isOpen() )
+        return;
+
+    QByteArray record;
+    QDataStream out( &record, QIODevice::WriteOnly );
+    out.setVersion( QDataStream::Qt_5_0 );
+    out << quint8( type ) << qint32( source->id() )
+        << qint32( destination->id() );
+
+    if ( edge )
+        out << edge->color() << edge->width() << edge->secondary();
+
+    journalRecord( record );
 }
 
-// show nodes numbers where number begins with 'prefix'
-void GraphWidget::showingNodeNumbersBeginWithNumber( const int& prefix,
-        const bool& show )
+void GraphWidget::journalRecord( const QByteArray& record )
 {
-    int i( 0 );
-    int hit( 0 );
+    m_journal.append( record );
+
+    if ( !m_journalTimer->isActive() )
+        m_journalTimer->start();
+}
 
-    for ( QList<Node*>::const_iterator it = m_nodeList.begin();
-          it != m_nodeList.end(); it++, i++ )
+// apply the records on the freshly loaded map. Stops at the first record
+// which does not fit the map, the list is cut there.
+void GraphWidget::replayJournal( QList<QByteArray>& records )
+{
+    for ( int i = 0; i < records.size(); i++ )
     {
-        // if nodenumber == 'prefix' the node is selected
-        if ( i == prefix )
+        QDataStream in( records.at( i ) );
+        in.setVersion( QDataStream::Qt_5_0 );
+        quint8 type;
+        in >> type;
+        bool applied( false );
+
+        switch ( type )
+        {
+            case Journal::NodeAdded:
+            case Journal::NodeState:
+                applied = replayNode( in, type == Journal::NodeAdded );
+                break;
+
+            case Journal::NodePosition:
+                {
+                    qint32 index;
+                    QPointF pos;
+                    in >> index >> pos;
+
+                    if ( in.status() != QDataStream::Ok ||
+                         index < 0 || index >= m_nodeList.size() )
+                        break;
+
+                    m_nodeList.at( index )->setPos( pos );
+                    applied = true;
+                    break;
+                }
+
+            case Journal::NodeRemoved:
+                {
+                    qint32 index;
+                    in >> index;
+
+                    // base node cannot be deleted
+                    if ( in.status() != QDataStream::Ok ||
+                         index <= 0 || index >= m_nodeList.size() )
+                        break;
+
+                    if ( m_nodeList.at( index ) == m_activeNode )
+                        setActiveNode( m_nodeList.first() );
+
+                    deleteNode( m_nodeList.at( index ) );
+                    applied = true;
+                    break;
+                }
+
+            case Journal::EdgeAdded:
+            case Journal::EdgeRemoved:
+                {
+                    qint32 source;
+                    qint32 destination;
+                    QColor color;
+                    qreal width;
+                    bool secondary;
+                    in >> source >> destination;
+
+                    if ( type == Journal::EdgeAdded )
+                        in >> color >> width >> secondary;
+
+                    if ( in.status() != QDataStream::Ok ||
+                         source < 0 || source >= m_nodeList.size() ||
+                         destination < 0 || destination >= m_nodeList.size() )
+                        break;
+
+                    Node* sourceNode = m_nodeList.at( source );
+                    Node* destNode = m_nodeList.at( destination );
+
+                    if ( type == Journal::EdgeRemoved )
+                    {
+                        if ( sourceNode->isConnected( destNode ) )
+                            deleteEdge( sourceNode->edgeTo( destNode ) );
+
+                        applied = true;
+                        break;
+                    }
+
+                    if ( sourceNode->isConnected( destNode ) )
+                        break;
+
+                    Edge* edge = createEdge( sourceNode, destNode );
+                    edge->setColor( color );
+                    edge->setWidth( width );
+                    edge->setSecondary( secondary );
+                    applied = true;
+                    break;
+                }
+
+            case Journal::Checkpoint:
+                applied = true;
+                break;
+
+            default:
+                break;
+        }
+
+        if ( !applied )
         {
-            hit++;
-            dynamic_cast<Node*>( *it )->showNumber( i, show, true );
-            m_hintNode = dynamic_cast<Node*>( *it );
-            continue;
+            records = records.mid( 0, i );
+            return;
         }
+    }
+}
+
+bool GraphWidget::replayNode( QDataStream& in, const bool& added )
+{
+    qint32 index;
+    QPointF pos;
+    qreal scale;
+    QColor color;
+    QColor textColor;
+    QString html;
+    qint32 edgeCount;
+    in >> index >> pos >> scale >> color >> textColor >> html >> edgeCount;
+
+    // a new Node is always appended
+    if ( in.status() != QDataStream::Ok ||
+         ( added ? index != m_nodeList.size() :
+           index < 0 || index >= m_nodeList.size() ) )
+        return false;
+
+    Node* node = added ?
+                 createNodeView( m_model.addNode() ) :
+                 m_nodeList.at( index );
+
+    if ( m_model.html( index ) != html )
+    {
+        // size of the new content is not known, decoded at once
+        m_model.setContent( index, html.toUtf8() );
+        m_model.setSize( index, QSizeF() );
+        node->loadFromModel();
+    }
+
+    node->setPos( pos );
+    // scale is relative to the current one
+    node->setScale( scale / node->scale() );
+    node->setColor( color );
+    node->setTextColor( textColor );
+
+    for ( int i = 0; i < edgeCount; i++ )
+    {
+        qint32 source;
+        QColor edgeColor;
+        qreal width;
+        bool secondary;
+        in >> source >> edgeColor >> width >> secondary;
 
-        // if 'i' starts with 'prefix'
-        if ( ( QString::number( i ) ).startsWith( QString::number( prefix ) ) )
+        if ( in.status() != QDataStream::Ok )
+            return false;
+
+        Edge* edge = source >= 0 && source < m_nodeList.size() ?
+                     node->edgeTo( m_nodeList.at( source ) ) :
+                     0;
+
+        if ( edge )
         {
-            hit++;
-            dynamic_cast<Node*>( *it )->showNumber( i, show );
+            edge->setColor( edgeColor );
+            edge->setWidth( width );
+            edge->setSecondary( secondary );
         }
     }
 
-    if ( hit == 1 )
+    return true;
+}
+
+void GraphWidget::compactJournal()
+{
+    // the snapshot is the saved state only if nothing is unsaved
+    if ( !m_journal.isOpen() || m_journal.isCompacting() ||
+         m_journal.hasUnsaved() || !m_journalDirty.isEmpty() ||
+         !m_journalMoved.isEmpty() )
+        return;
+
+    m_journal.beginCompaction();
+
+    if ( !m_journal.isCompacting() )
+        return;
+
+    // snapshot on this thread, serialization and disk write on a worker
+    m_compaction.setFuture( QtConcurrent::run( MindMapFile::write, snapshot(),
+                            m_journal.mapFileName(),
+                            static_cast<QAtomicInt*>( 0 ) ) );
+}
+
+void GraphWidget::closeJournal()
+{
+    if ( !m_journal.isOpen() )
+        return;
+
+    m_journalTimer->stop();
+
+    // a running compaction has to land first
+    waitForCompaction();
+    flushJournal();
+
+    // saved changes go to the file, so it opens without a replay.
+    // Written by the compaction worker, like any other compaction
+    if ( m_journal.size() > 0 )
+    {
+        compactJournal();
+        waitForCompaction();
+    }
+
+    // the user has chosen not to save the rest
+    m_journal.close( true );
+    m_journalDirty.clear();
+    m_journalMoved.clear();
+}
+
+void GraphWidget::waitForCompaction()
+{
+    if ( !m_journal.isCompacting() )
+        return;
+
+    if ( !m_compaction.isFinished() )
     {
-        nodeSelected( m_hintNode );
+        // no input meanwhile, the map must not change under the snapshot
+        QEventLoop loop;
+        connect( &m_compaction, SIGNAL( finished() ), &loop, SLOT( quit() ) );
+        m_parent->statusBarBusy();
+        loop.exec( QEventLoop::ExcludeUserInputEvents );
+        m_parent->statusBarProgress( -1 );
     }
-    else if ( hit == 0 )
+
+    compactionFinished();
+}
+
+// re-draw numbers
+void GraphWidget::showNodeNumbers()
+{
+    if ( m_hintNodes.isEmpty() )
+        assignNodeNumbers();
+
+    // a prefix of k digits is followed by 10^(digits-k) numbers
+    int count = 1;
+
+    for ( int i = m_hintNumber.length(); i < m_hintDigits; i++ )
+        count *= 10;
+
+    const int begin = m_hintNumber.length() > m_hintDigits ?
+                      m_hintNodes.size() :
+                      qMin( m_hintNumber.toInt() * count, m_hintNodes.size() );
+    const int end = qMin( begin + count, m_hintNodes.size() );
+
+    if ( begin == end )
     {
         m_showingNodeNumbers = false;
-        showingAllNodeNumbers( false );
+        hideNodeNumbers();
+    }
+    else if ( end - begin == 1 && !m_hintNumber.isEmpty() )
+    {
+        nodeSelected( m_hintNodes.at( begin ) );
+    }
+    else
+    {
+        showNodeNumberRange( begin, end );
+    }
+}
+
+void GraphWidget::hideNodeNumbers()
+{
+    showNodeNumberRange( 0, 0 );
+    // numbered again for the viewport of the next time
+    m_hintNodes.clear();
+}
+
+// in the order of IDs, the base Node gets the first if it is visible
+void GraphWidget::assignNodeNumbers()
+{
+    QVector<int> visible = m_nodeGrid.query( mapToScene( viewport()->rect() ).boundingRect() );
+    qSort( visible.begin(), visible.end() );
+    m_hintNodes.clear();
+
+    foreach ( int id, visible )
+    {
+        if ( m_nodeList.at( id )->isVisible() )
+            m_hintNodes.append( m_nodeList.at( id ) );
     }
+
+    m_hintDigits = 1;
+
+    for ( int count = 10; count < m_hintNodes.size(); count *= 10 )
+        m_hintDigits++;
 }
 
+// the first one is suggested, Enter selects it
+void GraphWidget::showNodeNumberRange( const int& begin, const int& end )
+{
+    for ( int i = m_hintBegin; i < qMin( m_hintEnd, begin ); i++ )
+        m_hintNodes.at( i )->showNumber( i, false );
+
+    for ( int i = qMax( m_hintBegin, end ); i < m_hintEnd; i++ )
+        m_hintNodes.at( i )->showNumber( i, false );
+
+    for ( int i = begin; i < qMin( end, m_hintBegin ); i++ )
+        m_hintNodes.at( i )->showNumber( i, true, false, m_hintDigits );
+
+    for ( int i = qMax( begin, m_hintEnd ); i < end; i++ )
+        m_hintNodes.at( i )->showNumber( i, true, false, m_hintDigits );
+
+    if ( m_hintBegin >= begin && m_hintBegin < end )
+        m_hintNodes.at( m_hintBegin )->showNumber( m_hintBegin, true, false, m_hintDigits );
+
+    if ( begin < end )
+        m_hintNodes.at( begin )->showNumber( begin, true, true, m_hintDigits );
+
+    m_hintBegin = begin;
+    m_hintEnd = end;
+    m_hintNode = begin < end ? m_hintNodes.at( begin ) : 0;
+}
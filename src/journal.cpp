@@ -0,0 +1,377 @@
+#include "include/journal.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+
+#include <string.h> // memcpy, memcmp
+
+#ifdef Q_OS_WIN
+#include <io.h> // _commit
+#else
+#include <unistd.h> // fsync
+#endif
+
+const char Journal::m_magic[4] = { 'Q', 'M', 'M', 'J' };
+const quint32 Journal::m_version = 1;
+
+// length + checksum in front of every record
+static const int frameHeaderSize = 8;
+
+Journal::Journal() :
+    m_unsaved( false ),
+    m_compacting( false ),
+    m_generation( 0 ),
+    m_parentGeneration( 0 ),
+    m_checkpointOffset( 0 )
+{
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+QString Journal::journalFileName( const QString& mapFileName )
+{
+    return mapFileName + ".journal";
+}
+
+QList<QByteArray> Journal::recover( const QString& mapFileName, bool& unsaved )
+{
+    const QString fileName = journalFileName( mapFileName );
+    QList<QByteArray> records;
+    QList<QByteArray> sideRecords;
+    Header journal;
+    Header side;
+
+    // a journal bound to an older base file is already in the base
+    const bool journalValid = readFile( fileName, journal, records ) &&
+                              journal.bound &&
+                              matchesBase( journal, mapFileName );
+
+    if ( !journalValid )
+        records.clear();
+
+    // side file of a compaction which did not finish. Bound: the new base
+    // has been committed, only the rename is missing. Unbound: the new base
+    // is not there or it is, but the journal is stale then.
+    if ( readFile( fileName + ".next", side, sideRecords ) )
+    {
+        const bool sideValid = side.bound ?
+                               matchesBase( side, mapFileName ) :
+                               !journalValid || side.parent == journal.generation;
+
+        if ( sideValid )
+            records.append( sideRecords );
+    }
+
+    int lastCheckpoint( -1 );
+
+    for ( int i = 0; i < records.size(); i++ )
+        if ( records.at( i ).at( 0 ) == char( Checkpoint ) )
+            lastCheckpoint = i;
+
+    unsaved = lastCheckpoint < records.size() - 1;
+    return records;
+}
+
+bool Journal::open( const QString& mapFileName, const QList<QByteArray>& records )
+{
+    close();
+    const QString fileName = journalFileName( mapFileName );
+    QFile::remove( fileName + ".next" );
+    m_file.setFileName( fileName );
+
+    if ( !m_file.open( QIODevice::ReadWrite | QIODevice::Truncate ) )
+        return false;
+
+    m_mapFileName = mapFileName;
+    m_unsaved = false;
+    m_compacting = false;
+    m_generation = quint32( QDateTime::currentMSecsSinceEpoch() );
+    m_parentGeneration = 0;
+
+    if ( !writeHeader( true ) )
+    {
+        close();
+        return false;
+    }
+
+    m_checkpointOffset = sizeof( Header );
+
+    foreach ( const QByteArray& record, records )
+    {
+        m_buffer.append( frame( record ) );
+        m_unsaved = record.at( 0 ) != char( Checkpoint );
+
+        if ( !m_unsaved )
+            m_checkpointOffset = sizeof( Header ) + m_buffer.size();
+    }
+
+    return flush();
+}
+
+void Journal::close( const bool& discardUnsaved )
+{
+    if ( !isOpen() )
+        return;
+
+    if ( m_compacting )
+        endCompaction( false );
+
+    if ( discardUnsaved )
+    {
+        m_buffer.clear();
+        m_file.resize( m_checkpointOffset );
+        sync();
+    }
+    else
+    {
+        flush();
+    }
+
+    const bool empty = m_file.size() <= qint64( sizeof( Header ) );
+    m_file.close();
+
+    if ( empty )
+        m_file.remove();
+
+    m_mapFileName.clear();
+    m_unsaved = false;
+}
+
+bool Journal::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString Journal::mapFileName() const
+{
+    return m_mapFileName;
+}
+
+void Journal::append( const QByteArray& record )
+{
+    m_buffer.append( frame( record ) );
+    m_unsaved = true;
+}
+
+void Journal::checkpoint()
+{
+    m_buffer.append( frame( QByteArray( 1, char( Checkpoint ) ) ) );
+    m_unsaved = false;
+    flush();
+    m_checkpointOffset = m_file.size();
+}
+
+bool Journal::flush()
+{
+    if ( !isOpen() )
+        return false;
+
+    if ( m_buffer.isEmpty() )
+        return true;
+
+    m_file.seek( m_file.size() );
+    const bool written = m_file.write( m_buffer ) == m_buffer.size();
+    m_buffer.clear();
+    return written && sync();
+}
+
+bool Journal::hasUnsaved() const
+{
+    return m_unsaved;
+}
+
+qint64 Journal::size() const
+{
+    return isOpen() ?
+           m_file.size() - qint64( sizeof( Header ) ) + m_buffer.size() :
+           0;
+}
+
+void Journal::beginCompaction()
+{
+    if ( !isOpen() || m_compacting )
+        return;
+
+    // everything until now goes to the base, the rest to the side file
+    flush();
+    m_file.close();
+    m_file.setFileName( journalFileName( m_mapFileName ) + ".next" );
+
+    if ( !m_file.open( QIODevice::ReadWrite | QIODevice::Truncate ) )
+    {
+        // keep on with the journal, it has nothing to compact into
+        m_file.setFileName( journalFileName( m_mapFileName ) );
+        m_file.open( QIODevice::ReadWrite );
+        return;
+    }
+
+    m_parentGeneration = m_generation;
+    m_generation++;
+    writeHeader( false );
+    m_checkpointOffset = sizeof( Header );
+    m_compacting = true;
+}
+
+void Journal::endCompaction( const bool& committed )
+{
+    if ( !m_compacting )
+        return;
+
+    flush();
+    m_compacting = false;
+    const QString fileName = journalFileName( m_mapFileName );
+
+    if ( committed )
+    {
+        // the side file becomes the journal of the new base
+        writeHeader( true );
+        m_file.close();
+        QFile::remove( fileName );
+        QFile::rename( fileName + ".next", fileName );
+        m_file.setFileName( fileName );
+        m_file.open( QIODevice::ReadWrite );
+        return;
+    }
+
+    // the base is unchanged, the side records go back to the journal.
+    // It gets a new generation, so the side file does not apply to it
+    // anymore, even if we die before it is removed.
+    m_file.seek( sizeof( Header ) );
+    const QByteArray sideRecords = m_file.readAll();
+    const qint64 sideCheckpoint = m_checkpointOffset - qint64( sizeof( Header ) );
+    m_file.close();
+
+    QFile journal( fileName );
+    journal.open( QIODevice::ReadOnly );
+    journal.seek( sizeof( Header ) );
+    const QByteArray records = journal.readAll();
+    journal.close();
+
+    m_parentGeneration = 0;
+    m_generation++;
+    const Header h = header( true );
+    QSaveFile combined( fileName );
+
+    if ( combined.open( QIODevice::WriteOnly ) )
+    {
+        combined.write( reinterpret_cast<const char*>( &h ), sizeof( h ) );
+        combined.write( records );
+        combined.write( sideRecords );
+
+        if ( combined.commit() )
+            QFile::remove( fileName + ".next" );
+    }
+
+    m_file.setFileName( fileName );
+    m_file.open( QIODevice::ReadWrite );
+    m_checkpointOffset = sizeof( Header ) + records.size() + sideCheckpoint;
+}
+
+bool Journal::isCompacting() const
+{
+    return m_compacting;
+}
+
+bool Journal::readFile( const QString& fileName, Header& header,
+                        QList<QByteArray>& records )
+{
+    QFile file( fileName );
+
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    if ( file.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) != qint64( sizeof( header ) ) ||
+         memcmp( header.magic, m_magic, sizeof( m_magic ) ) != 0 ||
+         header.version != m_version )
+        return false;
+
+    // a torn record at the end is the batch being written at the crash
+    const QByteArray data = file.readAll();
+    int pos( 0 );
+
+    while ( pos + frameHeaderSize <= data.size() )
+    {
+        quint32 length;
+        quint16 checksum;
+        memcpy( &length, data.constData() + pos, sizeof( length ) );
+        memcpy( &checksum, data.constData() + pos + sizeof( length ), sizeof( checksum ) );
+
+        if ( length == 0 ||
+             length > quint32( data.size() - pos - frameHeaderSize ) ||
+             qChecksum( data.constData() + pos + frameHeaderSize, length ) != checksum )
+            break;
+
+        records.append( data.mid( pos + frameHeaderSize, length ) );
+        pos += frameHeaderSize + length;
+    }
+
+    return true;
+}
+
+bool Journal::matchesBase( const Header& header, const QString& mapFileName )
+{
+    QFileInfo info( mapFileName );
+
+    return info.exists() &&
+           header.baseSize == info.size() &&
+           header.baseModified == info.lastModified().toMSecsSinceEpoch();
+}
+
+QByteArray Journal::frame( const QByteArray& record )
+{
+    const quint32 length = record.size();
+    const quint16 checksum = qChecksum( record.constData(), length );
+    const quint16 reserved( 0 );
+    QByteArray framed;
+    framed.reserve( frameHeaderSize + length );
+    framed.append( reinterpret_cast<const char*>( &length ), sizeof( length ) );
+    framed.append( reinterpret_cast<const char*>( &checksum ), sizeof( checksum ) );
+    framed.append( reinterpret_cast<const char*>( &reserved ), sizeof( reserved ) );
+    framed.append( record );
+    return framed;
+}
+
+Journal::Header Journal::header( const bool& bound ) const
+{
+    Header h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, m_magic, sizeof( h.magic ) );
+    h.version = m_version;
+    h.bound = bound;
+    h.generation = m_generation;
+    h.parent = m_parentGeneration;
+
+    if ( bound )
+    {
+        QFileInfo info( m_mapFileName );
+        h.baseSize = info.size();
+        h.baseModified = info.lastModified().toMSecsSinceEpoch();
+    }
+
+    return h;
+}
+
+bool Journal::writeHeader( const bool& bound )
+{
+    const Header h = header( bound );
+    m_file.seek( 0 );
+
+    return m_file.write( reinterpret_cast<const char*>( &h ), sizeof( h ) ) == qint64( sizeof( h ) ) &&
+           sync();
+}
+
+bool Journal::sync()
+{
+    if ( !m_file.flush() )
+        return false;
+
+#ifdef Q_OS_WIN
+    return _commit( m_file.handle() ) == 0;
+#else
+    return fsync( m_file.handle() ) == 0;
+#endif
+}
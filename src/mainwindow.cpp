@@ -26,6 +26,12 @@ MainWindow::MainWindow( QWidget* parent ) : QMainWindow( parent ), m_ui( new Ui:
     m_ui->mainToolBar->hide();
     setUpStatusIconToolbar();
     m_ui->statusIcons_toolBar->hide();
+    // shown while a file is written in the background
+    m_progressBar = new QProgressBar( this );
+    m_progressBar->setRange( 0, 100 );
+    m_progressBar->setMaximumWidth( 150 );
+    m_progressBar->hide();
+    m_ui->statusBar->addPermanentWidget( m_progressBar );
 }
 
 MainWindow::~MainWindow()
@@ -38,6 +44,26 @@ void MainWindow::statusBarMsg( const QString& msg )
     m_ui->statusBar->showMessage( msg, 5000 );
 }
 
+void MainWindow::statusBarProgress( const int& percent )
+{
+    if ( percent < 0 )
+    {
+        m_progressBar->hide();
+        return;
+    }
+
+    m_progressBar->setRange( 0, 100 );
+    m_progressBar->setValue( percent );
+    m_progressBar->show();
+}
+
+void MainWindow::statusBarBusy()
+{
+    // an empty range: the bar only shows that something is going on
+    m_progressBar->setRange( 0, 0 );
+    m_progressBar->show();
+}
+
 void MainWindow::contentChanged( const bool& changed )
 {
     if ( m_contentChanged == false && changed == true )
@@ -83,7 +109,7 @@ void MainWindow::openFile( const QString& fileName )
 
     if ( fileName.isEmpty() )
     {
-        QFileDialog dialog( this, tr( "Open MindMap" ), QDir::homePath(), QString( "QtMindMap (*.qmm)" ) );
+        QFileDialog dialog( this, tr( "Open MindMap" ), QDir::homePath(), QString( "QtMindMap (*.qmm *.qmmb)" ) );
         dialog.setAcceptMode( QFileDialog::AcceptOpen );
         dialog.setDefaultSuffix( "qmm" );
 
@@ -101,12 +127,16 @@ void MainWindow::openFile( const QString& fileName )
     if ( !fileInfo.isWritable() )
         statusBarMsg( tr( "Read-only file!" ) );
 
-    if ( !m_graphicsView->readContentFromXmlFile( m_fileName ) )
+    if ( !m_graphicsView->readContentFromFile( m_fileName ) )
     {
         m_fileName = currFilename;
         return;
     }
 
+    // changes of the previous session which did not reach the file
+    const bool recovered = fileInfo.isWritable() &&
+                           m_graphicsView->openJournal( m_fileName );
+
     m_ui->actionSaveAs->setEnabled( true );
     m_ui->actionClose->setEnabled( true );
     m_ui->actionExport->setEnabled( true );
@@ -117,6 +147,12 @@ void MainWindow::openFile( const QString& fileName )
     setTitle( m_fileName ) :
     setTitle( tr( "readonly " ).append( m_fileName ) );
     showMainToolbar();
+
+    if ( recovered )
+    {
+        contentChanged();
+        statusBarMsg( tr( "Unsaved changes recovered from the journal." ) );
+    }
 }
 
 void MainWindow::saveFile( const bool& checkIfReadonly )
@@ -129,8 +165,13 @@ void MainWindow::saveFile( const bool& checkIfReadonly )
         return;
     }
 
-    m_graphicsView->writeContentToXmlFile( m_fileName );
-    contentChanged( false );
+    // journaled map: a checkpoint in the journal saves it,
+    // otherwise the whole file is written in the background and the
+    // map is saved only when that succeeds
+    if ( m_graphicsView->saveJournal( m_fileName ) )
+        contentChanged( false );
+    else
+        m_graphicsView->writeContentToFile( m_fileName );
 }
 
 bool MainWindow::saveFileAs()
@@ -138,7 +179,7 @@ bool MainWindow::saveFileAs()
     QFileDialog dialog( this,
                         tr( "Save MindMap as" ),
                         QDir::homePath(),
-                        QString( "QtMindMap (*.qmm)" ) );
+                        QString( "QtMindMap (*.qmm *.qmmb)" ) );
     dialog.setAcceptMode( QFileDialog::AcceptSave );
     dialog.setDefaultSuffix( "qmm" );
 
@@ -179,6 +220,12 @@ bool MainWindow::closeFile()
                         saveFile();
                     }
 
+                    // the map stays open if it could not be written
+                    m_graphicsView->waitForBackgroundWrite();
+
+                    if ( m_contentChanged )
+                        return false;
+
                     break;
                 }
 
@@ -249,9 +296,11 @@ void MainWindow::showStatusIconToolbar( const bool& show )
         false );
 }
 
+// closed even if saved: writes are waited for and the journal is compacted
+// into the map file, so it opens without a replay
 void MainWindow::quit()
 {
-    if ( m_contentChanged && !closeFile() )
+    if ( !closeFile() )
         return;
 
     QApplication::instance()->quit();
@@ -259,7 +308,7 @@ void MainWindow::quit()
 
 void MainWindow::closeEvent( QCloseEvent* event )
 {
-    m_contentChanged&& !closeFile() ? event->ignore() : event->accept();
+    closeFile() ? event->accept() : event->ignore();
 }
 
 void MainWindow::keyPressEvent( QKeyEvent* event )
@@ -321,6 +370,12 @@ void MainWindow::setUpMainToolbar()
     connect( m_esc, SIGNAL( triggered() ), m_graphicsView, SLOT( nodeLostFocus() ) );
     m_hintMode = new QAction( tr( "Hint mode (f)" ), this );
     connect( m_hintMode, SIGNAL( triggered() ), m_graphicsView, SLOT( hintMode() ) );
+    m_treeLayout = new QAction( tr( "Tree layout (l)" ), this );
+    connect( m_treeLayout, SIGNAL( triggered() ), m_graphicsView, SLOT( treeLayout() ) );
+    m_radialLayout = new QAction( tr( "Radial layout (r)" ), this );
+    connect( m_radialLayout, SIGNAL( triggered() ), m_graphicsView, SLOT( radialLayout() ) );
+    m_forceLayout = new QAction( tr( "Force layout (g)" ), this );
+    connect( m_forceLayout, SIGNAL( triggered() ), m_graphicsView, SLOT( forceLayout() ) );
     m_showMainToolbar = new QAction( tr( "Show main toolbar\n(Ctrl m)" ), this );
     m_showMainToolbar->setShortcut( QKeySequence( Qt::CTRL + Qt::Key_M ) );
     connect( m_showMainToolbar, SIGNAL( triggered() ), this, SLOT( showMainToolbar() ) );
@@ -345,6 +400,9 @@ void MainWindow::setUpMainToolbar()
     m_ui->mainToolBar->addAction( m_zoomOut );
     m_ui->mainToolBar->addAction( m_esc );
     m_ui->mainToolBar->addAction( m_hintMode );
+    m_ui->mainToolBar->addAction( m_treeLayout );
+    m_ui->mainToolBar->addAction( m_radialLayout );
+    m_ui->mainToolBar->addAction( m_forceLayout );
     m_ui->mainToolBar->addAction( m_moveNode );
     m_ui->mainToolBar->addAction( m_subtree );
     m_ui->mainToolBar->addAction( m_showMainToolbar );
@@ -413,9 +471,11 @@ void MainWindow::setUpStatusIconToolbar()
 
 void MainWindow::setTitle( const QString& title )
 {
+    // the mark of unsaved content stays, a background write removes it
     title.isEmpty() ?
     setWindowTitle( "QtMindMap" ) :
-    setWindowTitle( QString( title ).append( " - QtMindMap" ) );
+    setWindowTitle( QString( m_contentChanged ? "* " : "" ).append( title ).
+                    append( " - QtMindMap" ) );
 }
 
 
@@ -0,0 +1,408 @@
+#include "include/mindmapfile.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+#include "include/binarymap.h"
+
+// report progress after this many nodes/edges
+static const int progressStep = 1024;
+
+static void reportProgress( QAtomicInt* progress, const int& done, const int& total )
+{
+    if ( progress && total > 0 && done % progressStep == 0 )
+        progress->store( int( qint64( 100 ) * done / total ) );
+}
+
+// same limits as Node::setScale and Edge::setWidth, out of range values
+// are left on the default
+static bool validScale( const qreal& scale )
+{
+    return scale >= 0.4 && scale <= 4;
+}
+
+static bool validWidth( const qreal& width )
+{
+    return width >= 1 && width <= 100;
+}
+
+// as QDom escapes an attribute value: line breaks and tabs as hexadecimal
+// references, > only where it would end a CDATA section
+static void writeAttribute( QTextStream& xml, const char* name, const QString& value )
+{
+    QString escaped;
+    escaped.reserve( value.size() );
+
+    for ( int i = 0; i < value.size(); i++ )
+    {
+        const QChar c = value.at( i );
+
+        if ( c == QLatin1Char( '<' ) )
+            escaped += QLatin1String( "&lt;" );
+        else if ( c == QLatin1Char( '"' ) )
+            escaped += QLatin1String( "&quot;" );
+        else if ( c == QLatin1Char( '&' ) )
+            escaped += QLatin1String( "&amp;" );
+        else if ( c == QLatin1Char( '>' ) && escaped.endsWith( QLatin1String( "]]" ) ) )
+            escaped += QLatin1String( "&gt;" );
+        else if ( c == QChar( 0xA ) || c == QChar( 0xD ) || c == QChar( 0x9 ) )
+            escaped += QLatin1String( "&#x" ) + QString::number( c.unicode(), 16 ) +
+                       QLatin1Char( ';' );
+        else
+            escaped += c;
+    }
+
+    xml << ' ' << name << "=\"" << escaped << '"';
+}
+
+static bool isBinary( const QString& fileName )
+{
+    return QFileInfo( fileName ).suffix() == "qmmb";
+}
+
+bool MindMapFile::read( const QString& fileName, MindMapModel& model,
+                        QString* error )
+{
+    return isBinary( fileName ) ?
+           readBinary( fileName, model, error ) :
+           readXml( fileName, model, error );
+}
+
+bool MindMapFile::readXml( const QString& fileName, MindMapModel& model,
+                           QString* error )
+{
+    model.clear();
+    // the subtree index is built once, when every edge is in
+    model.beginBulkUpdate();
+    QFile file( fileName );
+
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        if ( error )
+            *error = tr( "Couldn't read file." );
+
+        return false;
+    }
+
+    // one forward pass: nodes and edges are added as their elements
+    // arrive, the document itself is never held in memory.
+    // Nodes precede edges in the file, edges refer to them by index.
+    QXmlStreamReader xml( &file );
+
+    while ( !xml.atEnd() )
+    {
+        if ( xml.readNext() != QXmlStreamReader::StartElement )
+            continue;
+
+        const QXmlStreamAttributes attr = xml.attributes();
+
+        if ( xml.name() == QLatin1String( "node" ) )
+        {
+            const int node = model.addNode();
+            model.setContent( node, attr.value( "htmlContent" ).toString().toUtf8() );
+            model.setPos( node, QPointF( attr.value( "x" ).toFloat(),
+                                         attr.value( "y" ).toFloat() ) );
+
+            const qreal scale = attr.value( "scale" ).toFloat();
+
+            if ( validScale( scale ) )
+                model.setScale( node, scale );
+
+            model.setColor( node, qRgb( attr.value( "bg_red" ).toInt(),
+                                        attr.value( "bg_green" ).toInt(),
+                                        attr.value( "bg_blue" ).toInt() ) );
+            model.setTextColor( node, qRgb( attr.value( "text_red" ).toInt(),
+                                            attr.value( "text_green" ).toInt(),
+                                            attr.value( "text_blue" ).toInt() ) );
+        }
+        else if ( xml.name() == QLatin1String( "edge" ) )
+        {
+            const int source = attr.value( "source" ).toInt();
+            const int destination = attr.value( "destination" ).toInt();
+
+            if ( source < 0 || source >= model.nodeCount() ||
+                 destination < 0 || destination >= model.nodeCount() )
+            {
+                xml.raiseError( tr( "Edge refers to a missing node." ) );
+                break;
+            }
+
+            const int edge = model.addEdge( source, destination );
+            model.setEdgeColor( edge, qRgb( attr.value( "red" ).toInt(),
+                                            attr.value( "green" ).toInt(),
+                                            attr.value( "blue" ).toInt() ) );
+
+            const qreal width = attr.value( "width" ).toFloat();
+
+            if ( validWidth( width ) )
+                model.setEdgeWidth( edge, width );
+
+            model.setSecondary( edge, attr.value( "secondary" ).toInt() );
+        }
+    }
+
+    if ( xml.hasError() || model.nodeCount() == 0 )
+    {
+        model.clear();
+
+        if ( error )
+            *error = tr( "Couldn't parse XML file." );
+
+        return false;
+    }
+
+    model.endBulkUpdate();
+    return true;
+}
+
+bool MindMapFile::readBinary( const QString& fileName, MindMapModel& model,
+                              QString* error )
+{
+    model.clear();
+    // shared by the model and its copies, unmapped with the last one
+    QSharedPointer<QFile> file( new QFile( fileName ) );
+
+    if ( !file->open( QIODevice::ReadOnly ) )
+    {
+        if ( error )
+            *error = tr( "Couldn't read file." );
+
+        return false;
+    }
+
+    // the tables are read in place, content is not even copied
+    const qint64 size = file->size();
+    const uchar* data = size > 0 ? file->map( 0, size ) : 0;
+    const BinaryMap::Header* header =
+        reinterpret_cast<const BinaryMap::Header*>( data );
+
+    if ( !data || !BinaryMap::isValid( header, size ) || header->nodeCount == 0 )
+    {
+        if ( error )
+            *error = tr( "Couldn't parse binary file." );
+
+        return false;
+    }
+
+    const BinaryMap::NodeRecord* nodes =
+        reinterpret_cast<const BinaryMap::NodeRecord*>( data + header->nodeTableOffset );
+    const BinaryMap::EdgeRecord* edges =
+        reinterpret_cast<const BinaryMap::EdgeRecord*>( data + header->edgeTableOffset );
+    const char* heap = reinterpret_cast<const char*>( data + header->stringHeapOffset );
+    bool valid( true );
+    model.setMappedFile( file );
+    model.beginBulkUpdate();
+
+    for ( quint32 i = 0; i < header->nodeCount && valid; i++ )
+    {
+        const BinaryMap::NodeRecord& n = nodes[i];
+
+        if ( quint64( n.contentOffset ) + n.contentLength > header->stringHeapSize )
+        {
+            valid = false;
+            break;
+        }
+
+        const int node = model.addNode();
+        model.setContent( node, QByteArray::fromRawData( heap + n.contentOffset,
+                          n.contentLength ) );
+        model.setPos( node, QPointF( n.x, n.y ) );
+
+        if ( validScale( n.scale ) )
+            model.setScale( node, n.scale );
+
+        model.setSize( node, QSizeF( n.width, n.height ) );
+        model.setColor( node, qRgb( n.bgRed, n.bgGreen, n.bgBlue ) );
+        model.setTextColor( node, qRgb( n.textRed, n.textGreen, n.textBlue ) );
+    }
+
+    for ( quint32 i = 0; i < header->edgeCount && valid; i++ )
+    {
+        const BinaryMap::EdgeRecord& e = edges[i];
+
+        if ( e.source >= header->nodeCount || e.destination >= header->nodeCount )
+        {
+            valid = false;
+            break;
+        }
+
+        const int edge = model.addEdge( e.source, e.destination );
+        model.setEdgeColor( edge, qRgb( e.red, e.green, e.blue ) );
+
+        if ( validWidth( e.width ) )
+            model.setEdgeWidth( edge, e.width );
+
+        model.setSecondary( edge, e.secondary );
+    }
+
+    if ( !valid )
+    {
+        model.clear();
+
+        if ( error )
+            *error = tr( "Couldn't parse binary file." );
+
+        return false;
+    }
+
+    model.endBulkUpdate();
+    return true;
+}
+
+bool MindMapFile::write( const MindMapModel& model, const QString& fileName,
+                         QAtomicInt* progress )
+{
+    return isBinary( fileName ) ?
+           writeBinary( model, fileName, progress ) :
+           writeXml( model, fileName, progress );
+}
+
+bool MindMapFile::writeXml( const MindMapModel& model, const QString& fileName,
+                            QAtomicInt* progress )
+{
+    // written next to the target and renamed over it, never half-written
+    QSaveFile file( fileName );
+
+    if ( !file.open( QIODevice::WriteOnly ) )
+        return false;
+
+    // stream straight to the file, same layout and escaping as
+    // QDomDocument::toString(). QXmlStreamWriter escapes differently
+    QTextStream xml( &file );
+    xml.setCodec( "UTF-8" );
+    xml << "<!DOCTYPE QtMindMap>\n<qtmindmap>\n <nodes>\n";
+    const int total = model.nodeCount() + model.edgeCount();
+
+    for ( int i = 0; i < model.nodeCount(); i++ )
+    {
+        reportProgress( progress, i, total );
+        const QRgb color = model.color( i );
+        const QRgb textColor = model.textColor( i );
+        // no need to store ID: parsing order is preorder.
+        xml << "  <node";
+        writeAttribute( xml, "x", QString::number( model.pos( i ).x() ) );
+        writeAttribute( xml, "y", QString::number( model.pos( i ).y() ) );
+        writeAttribute( xml, "htmlContent", model.html( i ) );
+        writeAttribute( xml, "scale", QString::number( model.scale( i ) ) );
+        writeAttribute( xml, "bg_red", QString::number( qRed( color ) ) );
+        writeAttribute( xml, "bg_green", QString::number( qGreen( color ) ) );
+        writeAttribute( xml, "bg_blue", QString::number( qBlue( color ) ) );
+        writeAttribute( xml, "text_red", QString::number( qRed( textColor ) ) );
+        writeAttribute( xml, "text_green", QString::number( qGreen( textColor ) ) );
+        writeAttribute( xml, "text_blue", QString::number( qBlue( textColor ) ) );
+        xml << "/>\n";
+    }
+
+    xml << " </nodes>\n";
+
+    // edges
+    if ( model.edgeCount() == 0 )
+        xml << " <edges/>\n";
+    else
+        xml << " <edges>\n";
+
+    for ( int i = 0; i < model.edgeCount(); i++ )
+    {
+        reportProgress( progress, model.nodeCount() + i, total );
+        const QRgb color = model.edgeColor( i );
+        xml << "  <edge";
+        writeAttribute( xml, "source", QString::number( model.source( i ) ) );
+        writeAttribute( xml, "destination", QString::number( model.destination( i ) ) );
+        writeAttribute( xml, "red", QString::number( qRed( color ) ) );
+        writeAttribute( xml, "green", QString::number( qGreen( color ) ) );
+        writeAttribute( xml, "blue", QString::number( qBlue( color ) ) );
+        writeAttribute( xml, "width", QString::number( model.edgeWidth( i ) ) );
+        writeAttribute( xml, "secondary", QString::number( model.secondary( i ) ) );
+        xml << "/>\n";
+    }
+
+    if ( model.edgeCount() != 0 )
+        xml << " </edges>\n";
+
+    xml << "</qtmindmap>\n";
+    xml.flush();
+
+    return xml.status() == QTextStream::Ok && file.commit();
+}
+
+bool MindMapFile::writeBinary( const MindMapModel& model, const QString& fileName,
+                               QAtomicInt* progress )
+{
+    QVector<BinaryMap::NodeRecord> nodeTable( model.nodeCount() );
+    QByteArray heap;
+    const int total = model.nodeCount() + model.edgeCount();
+
+    for ( int i = 0; i < model.nodeCount(); i++ )
+    {
+        reportProgress( progress, i, total );
+        const QByteArray content = model.content( i );
+        // unknown size is stored invalid, the content is decoded at load then
+        const QSizeF size = model.size( i ).isValid() ? model.size( i ) : QSizeF( -1, -1 );
+        const QRgb color = model.color( i );
+        const QRgb textColor = model.textColor( i );
+        BinaryMap::NodeRecord& n = nodeTable[i];
+        n.x = model.pos( i ).x();
+        n.y = model.pos( i ).y();
+        n.scale = model.scale( i );
+        n.width = size.width();
+        n.height = size.height();
+        n.contentOffset = heap.size();
+        n.contentLength = content.size();
+        n.bgRed = qRed( color );
+        n.bgGreen = qGreen( color );
+        n.bgBlue = qBlue( color );
+        n.textRed = qRed( textColor );
+        n.textGreen = qGreen( textColor );
+        n.textBlue = qBlue( textColor );
+        heap.append( content );
+    }
+
+    QVector<BinaryMap::EdgeRecord> edgeTable( model.edgeCount() );
+
+    for ( int i = 0; i < model.edgeCount(); i++ )
+    {
+        reportProgress( progress, model.nodeCount() + i, total );
+        const QRgb color = model.edgeColor( i );
+        BinaryMap::EdgeRecord& e = edgeTable[i];
+        e.source = model.source( i );
+        e.destination = model.destination( i );
+        e.width = model.edgeWidth( i );
+        e.red = qRed( color );
+        e.green = qGreen( color );
+        e.blue = qBlue( color );
+        e.secondary = model.secondary( i );
+    }
+
+    // the record sizes are multiples of 8, the tables stay aligned
+    BinaryMap::Header header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, BinaryMap::magic, sizeof( header.magic ) );
+    header.version = BinaryMap::version;
+    header.byteOrder = BinaryMap::byteOrderMark;
+    header.nodeCount = nodeTable.size();
+    header.edgeCount = edgeTable.size();
+    header.nodeTableOffset = sizeof( BinaryMap::Header );
+    header.edgeTableOffset = header.nodeTableOffset +
+                             quint64( nodeTable.size() ) * sizeof( BinaryMap::NodeRecord );
+    header.stringHeapOffset = header.edgeTableOffset +
+                              quint64( edgeTable.size() ) * sizeof( BinaryMap::EdgeRecord );
+    header.stringHeapSize = heap.size();
+
+    // written next to the target and renamed over it: an opened binary map
+    // keeps its mapping of the old file
+    QSaveFile file( fileName );
+
+    if ( !file.open( QIODevice::WriteOnly ) )
+        return false;
+
+    file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    file.write( reinterpret_cast<const char*>( nodeTable.constData() ),
+                nodeTable.size() * sizeof( BinaryMap::NodeRecord ) );
+    file.write( reinterpret_cast<const char*>( edgeTable.constData() ),
+                edgeTable.size() * sizeof( BinaryMap::EdgeRecord ) );
+    file.write( heap );
+
+    return file.commit();
+}
@@ -0,0 +1,605 @@
+#include "include/mindmapmodel.h"
+
+#include <algorithm>
+
+// same as the Node's default background
+const QRgb MindMapModel::m_defaultColor = qRgb( 215, 235, 255 );
+
+// key of an edge in the index, same for both directions
+static quint64 pairKey( const int& node, const int& other )
+{
+    return node < other ?
+           ( quint64( node ) << 32 ) | quint32( other ) :
+           ( quint64( other ) << 32 ) | quint32( node );
+}
+
+MindMapModel::MindMapModel() :
+    m_bulkUpdate( false )
+{
+}
+
+void MindMapModel::clear()
+{
+    m_pos.clear();
+    m_scale.clear();
+    m_size.clear();
+    m_color.clear();
+    m_textColor.clear();
+    m_content.clear();
+    m_parentEdge.clear();
+    m_childEdges.clear();
+    m_secondaryEdges.clear();
+    m_order.clear();
+    m_first.clear();
+    m_subtreeSize.clear();
+    m_bulkUpdate = false;
+
+    m_source.clear();
+    m_destination.clear();
+    m_edgeColor.clear();
+    m_edgeWidth.clear();
+    m_secondary.clear();
+    m_sourceSlot.clear();
+    m_destinationSlot.clear();
+    m_edgeIndex.clear();
+
+    m_mappedFile.clear();
+}
+
+int MindMapModel::nodeCount() const
+{
+    return m_pos.size();
+}
+
+int MindMapModel::edgeCount() const
+{
+    return m_source.size();
+}
+
+int MindMapModel::addNode()
+{
+    m_pos.append( QPointF( 0, 0 ) );
+    m_scale.append( 1 );
+    m_size.append( QSizeF() );
+    m_color.append( m_defaultColor );
+    m_textColor.append( qRgb( 0, 0, 0 ) );
+    m_content.append( QByteArray() );
+    m_parentEdge.append( -1 );
+    m_childEdges.append( QVector<int>() );
+    m_secondaryEdges.append( QVector<int>() );
+    // a new root at the end of the pre-order
+    m_first.append( m_order.size() );
+    m_order.append( m_pos.size() - 1 );
+    m_subtreeSize.append( 1 );
+    return m_pos.size() - 1;
+}
+
+int MindMapModel::removeNode( const int& node )
+{
+    while ( degree( node ) > 0 )
+        removeEdge( incidentEdge( node, 0 ) );
+
+    const int last = m_pos.size() - 1;
+
+    // a lonely root now, its block of one goes to the end
+    if ( !m_bulkUpdate )
+    {
+        moveBlock( m_first.at( node ), 1, m_order.size() - 1 );
+        m_order.removeLast();
+    }
+
+    if ( node != last )
+    {
+        m_pos[node] = m_pos.at( last );
+        m_scale[node] = m_scale.at( last );
+        m_size[node] = m_size.at( last );
+        m_color[node] = m_color.at( last );
+        m_textColor[node] = m_textColor.at( last );
+        m_content[node] = m_content.at( last );
+        m_parentEdge[node] = m_parentEdge.at( last );
+        m_childEdges[node] = m_childEdges.at( last );
+        m_secondaryEdges[node] = m_secondaryEdges.at( last );
+        m_first[node] = m_first.at( last );
+        m_subtreeSize[node] = m_subtreeSize.at( last );
+
+        if ( !m_bulkUpdate )
+            m_order[m_first.at( node )] = node;
+
+        // edges of the moved node follow it, their slots stay
+        for ( int i = 0; i < degree( node ); i++ )
+            renameEnd( incidentEdge( node, i ), last, node );
+    }
+
+    m_pos.removeLast();
+    m_scale.removeLast();
+    m_size.removeLast();
+    m_color.removeLast();
+    m_textColor.removeLast();
+    m_content.removeLast();
+    m_parentEdge.removeLast();
+    m_childEdges.removeLast();
+    m_secondaryEdges.removeLast();
+    m_first.removeLast();
+    m_subtreeSize.removeLast();
+
+    return node != last ? last : -1;
+}
+
+QPointF MindMapModel::pos( const int& node ) const
+{
+    return m_pos.at( node );
+}
+
+void MindMapModel::setPos( const int& node, const QPointF& pos )
+{
+    m_pos[node] = pos;
+}
+
+qreal MindMapModel::scale( const int& node ) const
+{
+    return m_scale.at( node );
+}
+
+void MindMapModel::setScale( const int& node, const qreal& scale )
+{
+    m_scale[node] = scale;
+}
+
+QSizeF MindMapModel::size( const int& node ) const
+{
+    return m_size.at( node );
+}
+
+void MindMapModel::setSize( const int& node, const QSizeF& size )
+{
+    m_size[node] = size;
+}
+
+QRgb MindMapModel::color( const int& node ) const
+{
+    return m_color.at( node );
+}
+
+void MindMapModel::setColor( const int& node, const QRgb& color )
+{
+    m_color[node] = color;
+}
+
+QRgb MindMapModel::textColor( const int& node ) const
+{
+    return m_textColor.at( node );
+}
+
+void MindMapModel::setTextColor( const int& node, const QRgb& color )
+{
+    m_textColor[node] = color;
+}
+
+QByteArray MindMapModel::content( const int& node ) const
+{
+    return m_content.at( node );
+}
+
+void MindMapModel::setContent( const int& node, const QByteArray& content )
+{
+    m_content[node] = content;
+}
+
+QString MindMapModel::html( const int& node ) const
+{
+    return QString::fromUtf8( m_content.at( node ) );
+}
+
+int MindMapModel::addEdge( const int& source, const int& destination )
+{
+    const int edge = m_source.size();
+    m_source.append( source );
+    m_destination.append( destination );
+    m_edgeColor.append( qRgb( 0, 0, 0 ) );
+    m_edgeWidth.append( 1 );
+    m_secondary.append( false );
+    m_sourceSlot.append( -1 );
+    m_destinationSlot.append( -1 );
+    linkEdge( edge );
+    return edge;
+}
+
+int MindMapModel::removeEdge( const int& edge )
+{
+    unlinkEdge( edge );
+    const int last = m_source.size() - 1;
+
+    if ( edge != last )
+    {
+        const int source = m_source.at( last );
+        const int destination = m_destination.at( last );
+        m_source[edge] = source;
+        m_destination[edge] = destination;
+        m_edgeColor[edge] = m_edgeColor.at( last );
+        m_edgeWidth[edge] = m_edgeWidth.at( last );
+        m_secondary[edge] = m_secondary.at( last );
+        m_sourceSlot[edge] = m_sourceSlot.at( last );
+        m_destinationSlot[edge] = m_destinationSlot.at( last );
+
+        // the moved edge is referred with the new ID in its slots
+        if ( m_destinationSlot.at( edge ) == -1 )
+        {
+            m_parentEdge[destination] = edge;
+            m_childEdges[source][m_sourceSlot.at( edge )] = edge;
+        }
+        else
+        {
+            m_secondaryEdges[source][m_sourceSlot.at( edge )] = edge;
+            m_secondaryEdges[destination][m_destinationSlot.at( edge )] = edge;
+        }
+
+        m_edgeIndex.remove( pairKey( source, destination ), last );
+        m_edgeIndex.insert( pairKey( source, destination ), edge );
+    }
+
+    m_source.removeLast();
+    m_destination.removeLast();
+    m_edgeColor.removeLast();
+    m_edgeWidth.removeLast();
+    m_secondary.removeLast();
+    m_sourceSlot.removeLast();
+    m_destinationSlot.removeLast();
+
+    return edge != last ? last : -1;
+}
+
+int MindMapModel::source( const int& edge ) const
+{
+    return m_source.at( edge );
+}
+
+int MindMapModel::destination( const int& edge ) const
+{
+    return m_destination.at( edge );
+}
+
+int MindMapModel::otherEnd( const int& edge, const int& node ) const
+{
+    return m_source.at( edge ) == node ?
+           m_destination.at( edge ) :
+           m_source.at( edge );
+}
+
+QRgb MindMapModel::edgeColor( const int& edge ) const
+{
+    return m_edgeColor.at( edge );
+}
+
+void MindMapModel::setEdgeColor( const int& edge, const QRgb& color )
+{
+    m_edgeColor[edge] = color;
+}
+
+qreal MindMapModel::edgeWidth( const int& edge ) const
+{
+    return m_edgeWidth.at( edge );
+}
+
+void MindMapModel::setEdgeWidth( const int& edge, const qreal& width )
+{
+    m_edgeWidth[edge] = width;
+}
+
+bool MindMapModel::secondary( const int& edge ) const
+{
+    return m_secondary.at( edge );
+}
+
+void MindMapModel::setSecondary( const int& edge, const bool& secondary )
+{
+    if ( m_secondary.at( edge ) == secondary )
+        return;
+
+    // moves between the parent/child and the secondary lists
+    unlinkEdge( edge );
+    m_secondary[edge] = secondary;
+    linkEdge( edge );
+}
+
+int MindMapModel::edgeBetween( const int& node, const int& other ) const
+{
+    return m_edgeIndex.value( pairKey( node, other ), -1 );
+}
+
+int MindMapModel::parentEdge( const int& node ) const
+{
+    return m_parentEdge.at( node );
+}
+
+const QVector<int>& MindMapModel::childEdges( const int& node ) const
+{
+    return m_childEdges.at( node );
+}
+
+const QVector<int>& MindMapModel::secondaryEdges( const int& node ) const
+{
+    return m_secondaryEdges.at( node );
+}
+
+int MindMapModel::degree( const int& node ) const
+{
+    return ( m_parentEdge.at( node ) != -1 ? 1 : 0 ) +
+           m_childEdges.at( node ).size() +
+           m_secondaryEdges.at( node ).size();
+}
+
+// parent edge first, then the children and the secondaries
+int MindMapModel::incidentEdge( const int& node, int i ) const
+{
+    if ( m_parentEdge.at( node ) != -1 )
+    {
+        if ( i == 0 )
+            return m_parentEdge.at( node );
+
+        i--;
+    }
+
+    const QVector<int>& children = m_childEdges.at( node );
+
+    return i < children.size() ?
+           children.at( i ) :
+           m_secondaryEdges.at( node ).at( i - children.size() );
+}
+
+int MindMapModel::subtreeSize( const int& node ) const
+{
+    return m_subtreeSize.at( node );
+}
+
+int MindMapModel::subtreeNode( const int& node, const int& i ) const
+{
+    return m_order.at( m_first.at( node ) + i );
+}
+
+QVector<int> MindMapModel::subtree( const int& node ) const
+{
+    return m_order.mid( m_first.at( node ), m_subtreeSize.at( node ) );
+}
+
+// a node is its own ancestor
+bool MindMapModel::isAncestor( const int& ancestor, const int& node ) const
+{
+    return m_first.at( ancestor ) <= m_first.at( node ) &&
+           m_first.at( node ) < m_first.at( ancestor ) + m_subtreeSize.at( ancestor );
+}
+
+int MindMapModel::preorderNode( const int& i ) const
+{
+    return m_order.at( i );
+}
+
+int MindMapModel::preorderIndex( const int& node ) const
+{
+    return m_first.at( node );
+}
+
+void MindMapModel::beginBulkUpdate()
+{
+    m_bulkUpdate = true;
+}
+
+void MindMapModel::endBulkUpdate()
+{
+    m_bulkUpdate = false;
+    rebuildPreorder();
+}
+
+void MindMapModel::setMappedFile( const QSharedPointer<QFile>& file )
+{
+    m_mappedFile = file;
+}
+
+void MindMapModel::linkEdge( const int& edge )
+{
+    const int source = m_source.at( edge );
+    const int destination = m_destination.at( edge );
+
+    // cycles are found when the bulk update ends
+    if ( !m_secondary.at( edge ) && m_parentEdge.at( destination ) == -1 &&
+         ( m_bulkUpdate || !isAncestor( destination, source ) ) )
+    {
+        m_parentEdge[destination] = edge;
+        m_sourceSlot[edge] = m_childEdges.at( source ).size();
+        m_childEdges[source].append( edge );
+        m_destinationSlot[edge] = -1;
+
+        if ( !m_bulkUpdate )
+            attachSubtree( destination, source );
+    }
+    else
+    {
+        linkSecondary( edge );
+    }
+
+    m_edgeIndex.insert( pairKey( source, destination ), edge );
+}
+
+// an edge demoted to close no cycle is secondary from now on: drawn,
+// saved and laid out as one
+void MindMapModel::linkSecondary( const int& edge )
+{
+    const int source = m_source.at( edge );
+    const int destination = m_destination.at( edge );
+    m_secondary[edge] = true;
+    m_sourceSlot[edge] = m_secondaryEdges.at( source ).size();
+    m_secondaryEdges[source].append( edge );
+    m_destinationSlot[edge] = m_secondaryEdges.at( destination ).size();
+    m_secondaryEdges[destination].append( edge );
+}
+
+void MindMapModel::unlinkEdge( const int& edge )
+{
+    const int source = m_source.at( edge );
+    const int destination = m_destination.at( edge );
+
+    if ( m_destinationSlot.at( edge ) == -1 )
+    {
+        if ( !m_bulkUpdate )
+            detachSubtree( destination );
+
+        m_parentEdge[destination] = -1;
+        takeSlot( m_childEdges[source], source, m_sourceSlot.at( edge ) );
+    }
+    else
+    {
+        takeSlot( m_secondaryEdges[source], source, m_sourceSlot.at( edge ) );
+        // the slot is read again: a loop edge might have been moved
+        takeSlot( m_secondaryEdges[destination], destination,
+                  m_destinationSlot.at( edge ) );
+    }
+
+    m_edgeIndex.remove( pairKey( source, destination ), edge );
+}
+
+// the last edge of the list is moved to the freed slot
+void MindMapModel::takeSlot( QVector<int>& list, const int& node, const int& slot )
+{
+    const int last = list.size() - 1;
+
+    if ( slot != last )
+    {
+        const int moved = list.at( last );
+        list[slot] = moved;
+
+        // which end of the moved edge is this list
+        if ( m_source.at( moved ) == node && m_sourceSlot.at( moved ) == last )
+            m_sourceSlot[moved] = slot;
+        else
+            m_destinationSlot[moved] = slot;
+    }
+
+    list.removeLast();
+}
+
+void MindMapModel::renameEnd( const int& edge, const int& from, const int& to )
+{
+    m_edgeIndex.remove( pairKey( m_source.at( edge ), m_destination.at( edge ) ), edge );
+
+    if ( m_source.at( edge ) == from )
+        m_source[edge] = to;
+
+    if ( m_destination.at( edge ) == from )
+        m_destination[edge] = to;
+
+    m_edgeIndex.insert( pairKey( m_source.at( edge ), m_destination.at( edge ) ), edge );
+}
+
+int MindMapModel::parentNode( const int& node ) const
+{
+    const int edge = m_parentEdge.at( node );
+    return edge != -1 ? m_source.at( edge ) : -1;
+}
+
+// the root node's block goes right after the subtree of parent
+void MindMapModel::attachSubtree( const int& node, const int& parent )
+{
+    const int length = m_subtreeSize.at( node );
+    const int from = m_first.at( node );
+    const int end = m_first.at( parent ) + m_subtreeSize.at( parent );
+
+    for ( int ancestor = parent; ancestor != -1; ancestor = parentNode( ancestor ) )
+        m_subtreeSize[ancestor] += length;
+
+    moveBlock( from, length, from < end ? end - length : end );
+}
+
+// the node's block goes to the end as a new root, called before its
+// parent edge is cleared
+void MindMapModel::detachSubtree( const int& node )
+{
+    const int length = m_subtreeSize.at( node );
+
+    for ( int ancestor = parentNode( node ); ancestor != -1; ancestor = parentNode( ancestor ) )
+        m_subtreeSize[ancestor] -= length;
+
+    moveBlock( m_first.at( node ), length, m_order.size() - length );
+}
+
+// only the positions between the old and the new place change
+void MindMapModel::moveBlock( const int& from, const int& length, const int& to )
+{
+    if ( from == to )
+        return;
+
+    int* order = m_order.data();
+
+    if ( to < from )
+        std::rotate( order + to, order + from, order + from + length );
+    else
+        std::rotate( order + from, order + from + length, order + to + length );
+
+    for ( int i = qMin( from, to ); i < qMax( from, to ) + length; i++ )
+        m_first[order[i]] = i;
+}
+
+void MindMapModel::rebuildPreorder()
+{
+    m_order.clear();
+    m_order.reserve( m_pos.size() );
+    m_first.fill( -1 );
+
+    for ( int node = 0; node < m_pos.size(); node++ )
+        if ( m_parentEdge.at( node ) == -1 )
+            appendPreorder( node );
+
+    // nodes left out are on a cycle of primary edges: one of them
+    // becomes a root, its parent edge is indexed as a secondary
+    for ( int node = 0; node < m_pos.size(); node++ )
+    {
+        if ( m_first.at( node ) != -1 )
+            continue;
+
+        int onCycle = node;
+
+        while ( m_first.at( onCycle ) != -2 )
+        {
+            m_first[onCycle] = -2;
+            onCycle = parentNode( onCycle );
+        }
+
+        for ( int walked = node; m_first.at( walked ) == -2; walked = parentNode( walked ) )
+            m_first[walked] = -1;
+
+        const int edge = m_parentEdge.at( onCycle );
+        const int source = m_source.at( edge );
+        m_parentEdge[onCycle] = -1;
+        takeSlot( m_childEdges[source], source, m_sourceSlot.at( edge ) );
+        linkSecondary( edge );
+        appendPreorder( onCycle );
+    }
+
+    // descendants follow their ancestors, sum up backwards
+    m_subtreeSize.fill( 1 );
+
+    for ( int i = m_order.size() - 1; i >= 0; i-- )
+    {
+        const int parent = parentNode( m_order.at( i ) );
+
+        if ( parent != -1 )
+            m_subtreeSize[parent] += m_subtreeSize.at( m_order.at( i ) );
+    }
+}
+
+void MindMapModel::appendPreorder( const int& root )
+{
+    QVector<int> stack;
+    stack.append( root );
+
+    while ( !stack.isEmpty() )
+    {
+        const int node = stack.takeLast();
+        m_first[node] = m_order.size();
+        m_order.append( node );
+
+        // reversed, so the first child is visited first
+        const QVector<int>& children = m_childEdges.at( node );
+
+        for ( int i = children.size() - 1; i >= 0; i-- )
+            stack.append( m_destination.at( children.at( i ) ) );
+    }
+}
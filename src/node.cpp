@@ -5,139 +5,112 @@
 #include <QDebug>
 #include <QGraphicsSceneMouseEvent>
 #include <QTextDocument>
+#include <QTextDocumentFragment>
+#include <QAbstractTextDocumentLayout>
+#include <qdrawutil.h>
+#include <QFontMetricsF>
+#include <qmath.h>
+
+#include <limits>
+
+#include "include/itempool.h"
+#include "include/rendercache.h"
 
 const double Node::m_pi = 3.14159265358979323846264338327950288419717;
 const double Node::m_oneAndHalfPi = Node::m_pi * 1.5;
 const double Node::m_twoPi = Node::m_pi * 2.0;
-
-const QColor Node::m_gold( 215, 235, 255 );
-
-Node::Node( GraphWidget* parent ) :
+const qreal Node::m_cornerRadiusX = 20.0;
+const qreal Node::m_cornerRadiusY = 15.0;
+qreal Node::m_textDetail = 0.4;
+qreal Node::m_blockDetail = 0.15;
+const qreal Node::m_maxRenderSize = 2048;
+quint64 Node::m_editSerial = 0;
+// as QGraphicsDropShadowEffect drew it
+const qreal Node::m_shadowOffset = 4.0;
+const int Node::m_shadowBlur = 2;
+const QColor Node::m_shadowColor( 63, 63, 63, 180 );
+
+Node::Node( GraphWidget* parent, const int& id ) :
     m_graph( parent ),
+    m_id( id ),
     m_number( -1 ),
     m_hasBorder( false ),
     m_numberIsSpecial( false ),
-    m_color( m_gold ),
-    m_textColor( 0, 0, 0 ),
-    m_effect( new QGraphicsDropShadowEffect( this ) )
+    m_numberDigits( 1 ),
+    m_editing( false ),
+    m_loadingContent( false ),
+    m_contentEdited( false ),
+    m_documentConnected( false )
 {
+    // nothing else is allocated here: the document comes on demand,
+    // most Nodes of a big map never need it
     setFlag( ItemIsMovable );
     setFlag( ItemSendsGeometryChanges );
-    setCacheMode( DeviceCoordinateCache );
-    setDefaultTextColor( QColor( 0, 0, 0 ) );
     setZValue( 2 );
-    setGraphicsEffect( m_effect );
-    m_effect->setEnabled( false );
-    m_effect->setOffset( qreal( 4.0 ) );
 }
 
-Node::~Node()
+void* Node::operator new( size_t size )
 {
-    // dtor of Edge will call removeEdgeFromList on booth nodes.
-    foreach ( EdgeElement element, m_edgeList ) delete element.edge;
+    Q_ASSERT( size == sizeof( Node ) );
+    Q_UNUSED( size );
+    return ItemPool<Node>::allocate();
 }
 
-void Node::addEdge( Edge* edge, bool startsFromThisNode )
+void Node::operator delete( void* pointer )
 {
-    m_edgeList.push_back( EdgeElement( edge, startsFromThisNode ) );
-    edge->adjust();
+    ItemPool<Node>::deallocate( pointer );
 }
 
-void Node::deleteEdge( Node* otherEnd )
+int Node::id() const
 {
-    for ( QList<EdgeElement>::iterator it = m_edgeList.begin(); it != m_edgeList.end(); it++ )
-    {
-        if ( ( it->edge->sourceNode() == otherEnd && it->edge->destNode() == this )
-             || ( it->edge->sourceNode() == this && it->edge->destNode() == otherEnd ) )
-        {
-            delete it->edge;
-            return;
-        }
-    }
+    return m_id;
 }
 
-void Node::removeEdgeFromList( Edge* edge )
+void Node::setId( const int& id )
 {
-    for ( QList<EdgeElement>::iterator it = m_edgeList.begin(); it != m_edgeList.end(); it++ )
-    {
-        if ( it->edge == edge )
-        {
-            m_edgeList.erase( it );
-            return;
-        }
-    }
-}
-
-// edges from this Node. Exclude secondaries if needed (calc subtree)
-QList<Edge*> Node::edgesFrom( const bool& excludeSecondaries ) const
-{
-    QList<Edge*> list;
-
-    foreach ( EdgeElement element, m_edgeList )
-        if ( element.startsFromThisNode && ( !element.edge->secondary() || !excludeSecondaries ) )
-            list.push_back( element.edge );
-
-    return list;
-}
-
-// edges to this node (max 1 primary and any number of secondaries)
-QList<Edge*> Node::edgesToThis( const bool& excludeSecondaries ) const
-{
-    QList<Edge*> list;
-
-    foreach ( EdgeElement element, m_edgeList )
-        if ( !element.startsFromThisNode && ( !element.edge->secondary() || !excludeSecondaries ) )
-            list.push_back( element.edge );
-
-    return list;
+    m_id = id;
 }
 
 // the edge from this Node to the parameter Node
 Edge* Node::edgeTo( const Node* node ) const
 {
-    foreach ( EdgeElement element, m_edgeList )
-        if ( ( element.edge->sourceNode() == node  || element.edge->destNode() == node ) )
-            return element.edge;
-
-    return 0;
+    const int edge = m_graph->model().edgeBetween( m_id, node->id() );
+    return edge != -1 ? m_graph->edge( edge ) : 0;
 }
 
 QList<Node*> Node::subtree() const
 {
-    /** @note QList crashes if modified while traversal,
-      * QMutableListIterator lacks push_back, using good old std::list
-      */
-    std::list<Node*> list;
-    list.push_back( const_cast<Node*>( this ) );
-
-    // inorder: push_back the list of children Nodes of iterator
-    for ( std::list<Node*>::const_iterator it = list.begin(); it != list.end(); it++ )
-    {
-        QList<Edge*> edges = ( *it )->edgesFrom();
+    QList<Node*> list;
 
-        foreach ( Edge* edge, edges )
-            if ( !edge->secondary() )
-                list.push_back( edge->destNode() != this ? edge->destNode() : edge->sourceNode() );
-    }
+    foreach ( int node, m_graph->model().subtree( m_id ) )
+        list.push_back( m_graph->node( node ) );
 
-    return QList<Node*>::fromStdList( list );
+    return list;
 }
 
 // return thue if this and the parameter Node is connected with an edge
 bool Node::isConnected( const Node* node ) const
 {
-    foreach ( EdgeElement element, m_edgeList )
-        if ( element.edge->sourceNode() == node || element.edge->destNode() == node )
-            return true;
+    return m_graph->model().edgeBetween( m_id, node->id() ) != -1;
+}
+
+void Node::adjustEdges()
+{
+    const MindMapModel& model = m_graph->model();
 
-    return false;
+    for ( int i = 0; i < model.degree( m_id ); i++ )
+        m_graph->edge( model.incidentEdge( m_id, i ) )->adjust();
 }
 
 void Node::setBorder( const bool& hasBorder )
 {
+    if ( hasBorder == m_hasBorder )
+        return;
+
+    // the shadow is around the content
+    prepareGeometryChange();
     m_hasBorder = hasBorder;
-    m_effect->setEnabled( hasBorder );
-    update();
+    m_graph->updateIndex( this );
 }
 
 void Node::setEditable( const bool& editable )
@@ -145,9 +118,12 @@ void Node::setEditable( const bool& editable )
     if ( !editable )
     {
         setTextInteractionFlags( Qt::NoTextInteraction );
+        closeEditor();
         return;
     }
 
+    openEditor();
+
     setTextInteractionFlags( Qt::TextEditable );
     // set cursor to the end
     QTextCursor c = textCursor();
@@ -157,111 +133,283 @@ void Node::setEditable( const bool& editable )
 
 void Node::setColor( const QColor& color )
 {
-    m_color = color;
+    m_graph->model().setColor( m_id, color.rgb() );
     update();
 }
 
 QColor Node::color() const
 {
-    return m_color;
+    return QColor( m_graph->model().color( m_id ) );
 }
 
 void Node::setTextColor( const QColor& color )
 {
-    m_textColor = color;
+    m_graph->model().setTextColor( m_id, color.rgb() );
+
+    // not set in paint: it would lay out the document every time
+    if ( m_editing )
+        setDefaultTextColor( color );
+
     update();
 }
 
 QColor Node::textColor() const
 {
-    return m_textColor;
+    return QColor( m_graph->model().textColor( m_id ) );
 }
 
-void Node::setScale( const qreal& factor, const QRectF& sceneRect )
+void Node::setScale( const qreal& factor )
 {
     // limit scale to a reasonable size
     if ( factor * scale() < 0.4 || factor * scale() > 4 )
         return;
 
-    // cannot scale out the Node from the scene
-    if ( !sceneRect.contains( pos() + boundingRect().bottomRight() * scale() * factor ) )
-        return;
-
     prepareGeometryChange();
     QGraphicsTextItem::setScale( factor * scale() );
+    m_graph->model().setScale( m_id, scale() );
+    m_graph->updateIndex( this );
 
     // scale edges to this Node too
-    foreach ( EdgeElement element, m_edgeList )
+    const MindMapModel& model = m_graph->model();
+
+    for ( int i = 0; i < model.degree( m_id ); i++ )
     {
-        if ( !element.startsFromThisNode )
-            element.edge->setWidth( element.edge->width() * factor );
+        Edge* edge = m_graph->edge( model.incidentEdge( m_id, i ) );
+
+        if ( edge->destNode() == this )
+            edge->setWidth( edge->width() * factor );
 
-        element.edge->adjust();
+        edge->adjust();
     }
 }
 
-void Node::showNumber( const int& number, const bool& show, const bool& numberIsSpecial )
+void Node::showNumber( const int& number, const bool& show,
+                       const bool& numberIsSpecial, const int& digits )
 {
-    m_number = show ? number : -1;
+    const int shown = show ? number : -1;
+
+    if ( shown == m_number && numberIsSpecial == m_numberIsSpecial &&
+         digits == m_numberDigits )
+        return;
+
+    m_number = shown;
     m_numberIsSpecial = numberIsSpecial;
+    m_numberDigits = digits;
     update();
 }
 
 void Node::insertPicture( const QString& picture )
 {
+    // through the editor, closed again if it was not open
+    const bool editing = m_editing;
+    openEditor();
     QTextCursor c = textCursor();
     // strange, picture looks bad when node is scaled up
     c.insertHtml( QString( "<img src=" ).append( picture ). append( " width=15 height=15></img>" ) );
-    m_graph->contentChanged();
-    foreach ( EdgeElement element, m_edgeList ) element.edge->adjust();
+    m_graph->nodeChanged( this );
+
+    if ( !editing )
+        closeEditor();
+
+    m_graph->updateIndex( this );
+    adjustEdges();
 }
 
-QPointF Node::intersection( const QLineF& line, const bool& reverse ) const
+void Node::loadFromModel()
 {
-    /// @note What a shame, the following does not work,
-    /// doing it with brute (unaccurate) force
-    //    QPainterPath nodeShape(shape());
-    //    nodeShape.translate(pos());
-    //    QPainterPath l;
-    //    l.moveTo(line.p1());
-    //    l.lineTo(line.p2());
-    //    return nodeShape.intersected(l);
-    QPainterPath path;
-    path.addRoundedRect( sceneBoundingRect(), 28.0, 28.0 );
+    const MindMapModel& model = m_graph->model();
+    prepareGeometryChange();
+    m_contentEdited = false;
+    m_caption = QString();
+    m_renderKey = QString();
 
-    if ( reverse )
+    // the editor has the old content
+    if ( m_editing )
     {
-        for ( qreal t = 1; t != 0; t -= 0.01 )
-            if ( !path.contains( line.pointAt( t ) ) )
-                return line.pointAt( t );
+        m_editing = false;
+        setTextInteractionFlags( Qt::NoTextInteraction );
+        clearEditor();
     }
-    else
+
+    // without a size the boundingRect is not known until laid out
+    if ( !model.size( m_id ).isValid() )
+        m_graph->model().setSize( m_id, layout( model.html( m_id ) )->size() );
+
+    QGraphicsTextItem::setScale( model.scale( m_id ) );
+    setPos( model.pos( m_id ) );
+    // setPos does not report an unchanged position
+    m_graph->updateIndex( this );
+}
+
+void Node::syncContent()
+{
+    if ( !m_contentEdited )
+        return;
+
+    // toHtml() walks the whole document, only after edits
+    m_contentEdited = false;
+    m_graph->model().setContent( m_id, toHtml().toUtf8() );
+    m_graph->model().setSize( m_id, QGraphicsTextItem::boundingRect().size() );
+}
+
+void Node::openEditor()
+{
+    if ( m_editing )
+        return;
+
+    prepareGeometryChange();
+    m_editing = true;
+    connectDocument();
+    m_loadingContent = true;
+    setHtml( m_graph->model().html( m_id ) );
+    setDefaultTextColor( textColor() );
+    m_loadingContent = false;
+    const QSizeF size = QGraphicsTextItem::boundingRect().size();
+
+    // the layout differs from the one it was saved with (fonts...)
+    if ( size != m_graph->model().size( m_id ) )
+    {
+        m_graph->model().setSize( m_id, size );
+        m_graph->updateIndex( this );
+        adjustEdges();
+    }
+}
+
+void Node::closeEditor()
+{
+    if ( !m_editing )
+        return;
+
+    syncContent();
+    prepareGeometryChange();
+    m_editing = false;
+    // back to sharing renderings with same content
+    m_renderKey = QString();
+    clearEditor();
+}
+
+void Node::clearEditor()
+{
+    // the document of QGraphicsTextItem can not be deleted,
+    // its content and layout is released
+    m_loadingContent = true;
+    setPlainText( QString() );
+    m_loadingContent = false;
+}
+
+// laid out in a document shared by every Node which is not edited
+QTextDocument* Node::layout( const QString& html ) const
+{
+    static QTextDocument* document = new QTextDocument();
+    document->setDefaultFont( font() );
+    document->setHtml( html );
+    return document;
+}
+
+QRectF Node::boundingRect() const
+{
+    // the same on every side, the center stays the one of the content
+    const qreal margin = m_hasBorder ? m_shadowOffset + m_shadowBlur : 0;
+    return contentRect().adjusted( -margin, -margin, margin, margin );
+}
+
+QRectF Node::contentRect() const
+{
+    return m_editing ?
+           QGraphicsTextItem::boundingRect() :
+           QRectF( QPointF( 0, 0 ), m_graph->model().size( m_id ) );
+}
+
+// exact point where the line leaves the shape() of this Node, starting from
+// its end inside the Node: p2 if reverse, p1 otherwise.
+// The corners are quarter ellipses, solved in closed form
+QPointF Node::intersection( const QLineF& line, const bool& reverse ) const
+{
+    const QPointF origin = reverse ? line.p2() : line.p1();
+    const QPointF target = reverse ? line.p1() : line.p2();
+    const qreal dx = target.x() - origin.x();
+    const qreal dy = target.y() - origin.y();
+
+    // shape() in scene coordinates: radii scale with the Node,
+    // and are limited to the half of the sides as QPainterPath does
+    const QRectF rect = mapRectToScene( contentRect() );
+    const qreal rx = qMin( m_cornerRadiusX * scale(), rect.width() / 2 );
+    const qreal ry = qMin( m_cornerRadiusY * scale(), rect.height() / 2 );
+    const qreal innerX = rect.width() / 2 - rx;
+    const qreal innerY = rect.height() / 2 - ry;
+    const QPointF center = rect.center();
+
+    if ( !rect.contains( origin ) ||
+         outsideCorner( origin, center, innerX, innerY, rx, ry ) )
+        return origin;
+
+    // leaving the rectangle first
+    qreal s = std::numeric_limits<qreal>::max();
+
+    if ( dx > 0 )
+        s = ( rect.right() - origin.x() ) / dx;
+    else if ( dx < 0 )
+        s = ( rect.left() - origin.x() ) / dx;
+
+    if ( dy > 0 )
+        s = qMin( s, ( rect.bottom() - origin.y() ) / dy );
+    else if ( dy < 0 )
+        s = qMin( s, ( rect.top() - origin.y() ) / dy );
+
+    // the line is a point
+    if ( s == std::numeric_limits<qreal>::max() )
+        return origin;
+
+    const QPointF exit( origin.x() + s * dx, origin.y() + s * dy );
+
+    // through a cut corner: the farther root of the line and its ellipse
+    if ( rx > 0 && ry > 0 &&
+         qAbs( exit.x() - center.x() ) > innerX &&
+         qAbs( exit.y() - center.y() ) > innerY )
     {
-        for ( qreal t = 0; t != 1; t += 0.01 )
-            if ( !path.contains( line.pointAt( t ) ) )
-                return line.pointAt( t );
+        const qreal kx = center.x() + ( exit.x() > center.x() ? innerX : -innerX );
+        const qreal ky = center.y() + ( exit.y() > center.y() ? innerY : -innerY );
+        const qreal ux = ( origin.x() - kx ) / rx;
+        const qreal uy = ( origin.y() - ky ) / ry;
+        const qreal vx = dx / rx;
+        const qreal vy = dy / ry;
+        const qreal a = vx * vx + vy * vy;
+        const qreal b = ux * vx + uy * vy;
+        const qreal c = ux * ux + uy * uy - 1;
+        s = ( -b + qSqrt( qMax( qreal( 0 ), b * b - a * c ) ) ) / a;
     }
 
-    return QPointF( 0, 0 );
+    // the other end is inside too, the Nodes overlap
+    if ( s >= 1 )
+        return target;
+
+    return QPointF( origin.x() + s * dx, origin.y() + s * dy );
 }
 
 double Node::calculateBiggestAngle() const
 {
+    const MindMapModel& model = m_graph->model();
+    const int degree = model.degree( m_id );
+
     // in no edge, return with 12 o'clock
-    if ( m_edgeList.empty() )
+    if ( degree == 0 )
         return Node::m_oneAndHalfPi;
 
     // if there is only one edge, return with it's extension
-    if ( m_edgeList.size() == 1 )
-        return m_edgeList.first().startsFromThisNode ? Node::m_pi - m_edgeList.first().edge->angle() : Node::m_twoPi - m_edgeList.first().edge->angle();
+    if ( degree == 1 )
+    {
+        const int edge = model.incidentEdge( m_id, 0 );
+        return model.source( edge ) == m_id ? Node::m_pi - m_graph->edge( edge )->angle() : Node::m_twoPi - m_graph->edge( edge )->angle();
+    }
 
     // put angles of every edges from this node to a list
     QList<double> tmp;
 
-    for ( QList<EdgeElement>::const_iterator it = m_edgeList.begin();
-          it != m_edgeList.end(); it++ )
+    for ( int i = 0; i < degree; i++ )
     {
-        tmp.push_back( it->startsFromThisNode ? it->edge->angle() : doubleModulo( Node::m_pi + it->edge->angle(), Node::m_twoPi ) );
+        const int edge = model.incidentEdge( m_id, i );
+        const double angle = m_graph->edge( edge )->angle();
+        tmp.push_back( model.source( edge ) == m_id ? angle : doubleModulo( Node::m_pi + angle, Node::m_twoPi ) );
     }
 
     qSort( tmp.begin(), tmp.end() );
@@ -325,8 +473,9 @@ void Node::keyPressEvent( QKeyEvent* event )
         default:
             // not cursor movement: editing
             QGraphicsTextItem::keyPressEvent( event );
-            m_graph->contentChanged();
-            foreach ( EdgeElement element, m_edgeList ) element.edge->adjust();
+            m_graph->nodeChanged( this );
+            m_graph->updateIndex( this );
+            adjustEdges();
     }
 
     ///@note leaving editing mode is done with esc, handled by graphwidget
@@ -335,6 +484,81 @@ void Node::keyPressEvent( QKeyEvent* event )
 void Node::paint( QPainter* painter,
                   const QStyleOptionGraphicsItem* option,
                   QWidget* w )
+{
+    // zoomed out: no rich text, the content is not even laid out for it.
+    // Hint mode and editing are always in full detail
+    const qreal detail = QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                             painter->worldTransform() );
+
+    // shadow of the active Node, 9 pieces of one shared pixmap
+    if ( m_hasBorder )
+    {
+        const QPixmap& texture = shadow();
+        const QMargins margins( texture.width() / 2, texture.height() / 2,
+                                texture.width() / 2, texture.height() / 2 );
+        qDrawBorderPixmap( painter,
+                           contentRect().translated( m_shadowOffset, m_shadowOffset ).adjusted(
+                               -m_shadowBlur, -m_shadowBlur, m_shadowBlur, m_shadowBlur ).toRect(),
+                           margins, texture );
+    }
+
+    if ( detail < m_textDetail && m_number == -1 && !m_editing )
+    {
+        paintLowDetail( painter, detail );
+        return;
+    }
+
+    // the editor changes at every keystroke, not cached
+    if ( m_editing )
+        paintContent( painter, option, w );
+    else
+        paintCached( painter, option, w, detail );
+
+    // print num to topleft corner in hint mode.
+    if ( m_number != -1 )
+    {
+        painter->setPen( Qt::white );
+        painter->setBackground( Qt::red );
+        painter->setBackgroundMode( Qt::OpaqueMode );
+        painter->drawText( contentRect().topLeft() + QPointF( 0, 11 ),
+                           QString( "%1" ).arg( m_number, m_numberDigits, 10, QChar( '0' ) ) );
+    }
+}
+
+// rounded rect grown with the blur, blurred by layers of the color,
+// denser inwards. Made once, the middle row and column are stretched
+const QPixmap& Node::shadow()
+{
+    static QPixmap texture;
+
+    if ( texture.isNull() )
+    {
+        const int marginX = qCeil( m_cornerRadiusX ) + m_shadowBlur;
+        const int marginY = qCeil( m_cornerRadiusY ) + m_shadowBlur;
+        QImage image( 2 * marginX + 1, 2 * marginY + 1, QImage::Format_ARGB32_Premultiplied );
+        image.fill( Qt::transparent );
+        QPainter painter( &image );
+        painter.setRenderHint( QPainter::Antialiasing );
+        painter.setPen( Qt::NoPen );
+        QColor layer( m_shadowColor );
+        layer.setAlpha( m_shadowColor.alpha() / ( m_shadowBlur + 1 ) );
+        painter.setBrush( layer );
+
+        for ( int i = 0; i <= m_shadowBlur; i++ )
+            painter.drawRoundedRect( QRectF( image.rect() ).adjusted( i, i, -i, -i ),
+                                     m_cornerRadiusX + m_shadowBlur - i,
+                                     m_cornerRadiusY + m_shadowBlur - i );
+
+        painter.end();
+        texture = QPixmap::fromImage( image );
+    }
+
+    return texture;
+}
+
+void Node::paintContent( QPainter* painter,
+                         const QStyleOptionGraphicsItem* option,
+                         QWidget* w )
 {
     // draw background in hint mode. num == -1 : not in hint mode
     // if m_numberIsSpecial (can be selected with enter) bg is green, not yellow
@@ -343,7 +567,7 @@ void Node::paint( QPainter* painter,
         painter->setPen( Qt::transparent );
         //painter->setBrush( m_numberIsSpecial ? Qt::green : Qt::yellow );
         painter->setBrush( m_numberIsSpecial ? Qt::green : Qt::gray );
-        painter->drawRoundedRect( boundingRect(), 20.0, 15.0 );
+        painter->drawRoundedRect( contentRect(), m_cornerRadiusX, m_cornerRadiusY );
     }
     else
     {
@@ -351,54 +575,147 @@ void Node::paint( QPainter* painter,
         painter->setPen( QPen( QBrush( Qt::lightGray ), 1 ) ) : // border is scaled
         //painter->setPen( QPen( QBrush( Qt::black ), 1 ) ) : // border is scaled
         painter->setPen( Qt::transparent );
-        painter->setBrush( m_color );
-        painter->drawRoundedRect( boundingRect(), 20.0, 15.0 );
+        painter->setBrush( color() );
+        painter->drawRoundedRect( contentRect(), m_cornerRadiusX, m_cornerRadiusY );
     }
 
     painter->setBrush( Qt::NoBrush );
-    // the text itself
-    setDefaultTextColor( m_textColor );
-    QGraphicsTextItem::paint( painter, option, w );
 
-    // print num to topleft corner in hint mode.
-    if ( m_number != -1 )
+    // the text itself: the editor, or the content from the model
+    if ( m_editing )
     {
-        painter->setPen( Qt::white );
-        painter->setBackground( Qt::red );
-        painter->setBackgroundMode( Qt::OpaqueMode );
-        painter->drawText( boundingRect().topLeft() + QPointF( 0, 11 ),
-                           QString( "%1" ).arg( m_number ) );
+        QGraphicsTextItem::paint( painter, option, w );
+        return;
     }
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette.setColor( QPalette::Text, textColor() );
+    context.clip = option->exposedRect;
+    layout( m_graph->model().html( m_id ) )->documentLayout()->draw( painter, context );
 }
 
-QVariant Node::itemChange( GraphicsItemChange change, const QVariant& value )
+void Node::paintCached( QPainter* painter,
+                        const QStyleOptionGraphicsItem* option,
+                        QWidget* w, const qreal& detail )
 {
-    switch ( change )
+    const QRectF rect = contentRect();
+    const int bucket = RenderCache::bucket( detail );
+    const qreal scale = RenderCache::bucketScale( bucket );
+
+    // zoomed in a lot on a big Node, not worth to keep
+    if ( qMax( rect.width(), rect.height() ) * scale > m_maxRenderSize )
     {
-        case ItemPositionChange:
-            {
-                // Node is about to move, check borders
-                QPointF newPos = value.toPointF();
-                // the fence is reduced with the size of the node
-                QRectF rect ( scene()->sceneRect().topLeft(),
-                              scene()->sceneRect().bottomRight() -
-                              boundingRect().bottomRight() * scale() );
-
-                if ( !rect.contains( newPos ) )
-                {
-                    // Keep the item inside the scene rect.
-                    newPos.setX( qMin( rect.right(), qMax( newPos.x(), rect.left() ) ) );
-                    newPos.setY( qMin( rect.bottom(), qMax( newPos.y(), rect.top() ) ) );
-                    return newPos;
-                }
+        paintContent( painter, option, w );
+        return;
+    }
 
-                break;
-            }
+    const QString key = renderKey();
+    QPixmap pixmap;
 
+    // while zooming, a near zoom level scaled will do,
+    // refined when the zooming stops
+    const bool found = m_graph->zooming() ?
+                       RenderCache::findNearest( key, bucket, pixmap ) :
+                       RenderCache::find( key, bucket, pixmap );
+
+    if ( !found )
+    {
+        pixmap = QPixmap( qCeil( rect.width() * scale ), qCeil( rect.height() * scale ) );
+        pixmap.fill( Qt::transparent );
+        QPainter pixmapPainter( &pixmap );
+        pixmapPainter.setRenderHints( painter->renderHints() );
+        pixmapPainter.scale( scale, scale );
+        pixmapPainter.translate( -rect.topLeft() );
+        // all of it, without focus or selection state
+        QStyleOptionGraphicsItem whole( *option );
+        whole.exposedRect = rect;
+        whole.state = QStyle::State_None;
+        paintContent( &pixmapPainter, &whole, w );
+        pixmapPainter.end();
+        RenderCache::insert( key, bucket, pixmap );
+    }
+
+    painter->drawPixmap( rect, pixmap, QRectF( pixmap.rect() ) );
+}
+
+// what the rendering of the Node depends on, besides the zoom
+QString Node::renderKey()
+{
+    // the content is identified by its hash while it is the one in the
+    // model, edits get a new serial number
+    if ( m_renderKey.isNull() )
+    {
+        const QByteArray content = m_graph->model().content( m_id );
+        m_renderKey = QString( "c%1.%2" ).arg( qHash( content ) ).arg( content.size() );
+    }
+
+    // background: color or the ones of hint mode
+    const int background = m_number == -1 ? 0 : m_numberIsSpecial ? 2 : 1;
+    const QSizeF size = contentRect().size();
+    return QString( "%1:%2:%3:%4:%5:%6x%7" ).arg( m_renderKey )
+           .arg( m_graph->model().color( m_id ) )
+           .arg( m_graph->model().textColor( m_id ) )
+           .arg( int( m_hasBorder ) )
+           .arg( background )
+           .arg( size.width() ).arg( size.height() );
+}
+
+void Node::paintLowDetail( QPainter* painter, const qreal& detail )
+{
+    // a flat block, not even rounded
+    if ( detail < m_blockDetail )
+    {
+        painter->fillRect( contentRect(), color() );
+        return;
+    }
+
+    m_hasBorder ?
+    painter->setPen( QPen( QBrush( Qt::lightGray ), 1 ) ) :
+    painter->setPen( Qt::transparent );
+    painter->setBrush( color() );
+    painter->drawRoundedRect( contentRect(), m_cornerRadiusX, m_cornerRadiusY );
+
+    // first line of the text as a caption
+    if ( m_caption.isNull() )
+    {
+        const QString text = m_editing ?
+                             toPlainText() :
+                             QTextDocumentFragment::fromHtml(
+                                 m_graph->model().html( m_id ) ).toPlainText();
+        m_caption = QFontMetricsF( font() ).elidedText(
+                        text.section( QChar( '\n' ), 0, 0 ).simplified(),
+                        Qt::ElideRight, contentRect().width() );
+
+        // not null, so it is not calculated again
+        if ( m_caption.isNull() )
+            m_caption = QString( "" );
+    }
+
+    painter->setPen( textColor() );
+    painter->setFont( font() );
+    painter->drawText( contentRect(), Qt::AlignCenter | Qt::TextSingleLine,
+                       m_caption );
+}
+
+void Node::setDetailThresholds( const qreal& textDetail, const qreal& blockDetail )
+{
+    m_textDetail = textDetail;
+    m_blockDetail = qMin( blockDetail, textDetail );
+}
+
+QVariant Node::itemChange( GraphicsItemChange change, const QVariant& value )
+{
+    switch ( change )
+    {
         case ItemPositionHasChanged:
             // Notify parent, adjust edges that a move has happended.
-            m_graph->contentChanged();
-            foreach ( EdgeElement element, m_edgeList ) element.edge->adjust();
+            m_graph->model().setPos( m_id, pos() );
+            m_graph->nodePositionChanged( this );
+            m_graph->updateIndex( this );
+
+            if ( !m_graph->movingNodes() )
+                adjustEdges();
+
             break;
 
         default:
@@ -422,6 +739,7 @@ void Node::mouseDoubleClickEvent( QGraphicsSceneMouseEvent* event )
 
 void Node::mouseReleaseEvent( QGraphicsSceneMouseEvent* event )
 {
+    m_graph->nodeReleased();
     QGraphicsItem::mouseReleaseEvent( event );
 }
 
@@ -434,7 +752,7 @@ void Node::mouseMoveEvent( QGraphicsSceneMouseEvent* event )
 QPainterPath Node::shape () const
 {
     QPainterPath path;
-    path.addRoundedRect( boundingRect(), 20.0, 15.0 );
+    path.addRoundedRect( contentRect(), m_cornerRadiusX, m_cornerRadiusY );
     return path;
 }
 
@@ -446,6 +764,39 @@ void Node::focusOutEvent( QFocusEvent* event )
     m_graph->nodeLostFocus();
 }
 
+void Node::contentEdited()
+{
+    if ( !m_loadingContent )
+    {
+        m_contentEdited = true;
+        m_caption = QString();
+        m_renderKey = QString( "e%1" ).arg( ++m_editSerial );
+    }
+}
+
+void Node::connectDocument()
+{
+    if ( m_documentConnected )
+        return;
+
+    m_documentConnected = true;
+    connect( document(), &QTextDocument::contentsChanged, this, &Node::contentEdited );
+}
+
+// point in one of the cut corners of the rounded rectangle, off its arc
+bool Node::outsideCorner( const QPointF& point, const QPointF& center,
+                          const qreal& innerX, const qreal& innerY,
+                          const qreal& rx, const qreal& ry )
+{
+    const qreal x = qAbs( point.x() - center.x() ) - innerX;
+    const qreal y = qAbs( point.y() - center.y() ) - innerY;
+
+    if ( x <= 0 || y <= 0 )
+        return false;
+
+    return ( x / rx ) * ( x / rx ) + ( y / ry ) * ( y / ry ) > 1;
+}
+
 // there is no such thing as modulo operator for double :P
 double Node::doubleModulo( const double& devided, const double& devisor ) const
 {
@@ -0,0 +1,55 @@
+#include "include/rendercache.h"
+
+#include <QPixmapCache>
+#include <qmath.h>
+
+const qreal RenderCache::m_step = 1.2;
+const int RenderCache::m_nearest = 3;
+
+void RenderCache::setBudget( const int& kilobytes )
+{
+    QPixmapCache::setCacheLimit( kilobytes );
+}
+
+int RenderCache::budget()
+{
+    return QPixmapCache::cacheLimit();
+}
+
+int RenderCache::bucket( const qreal& detail )
+{
+    return qRound( qLn( detail ) / qLn( m_step ) );
+}
+
+qreal RenderCache::bucketScale( const int& bucket )
+{
+    return qPow( m_step, bucket );
+}
+
+bool RenderCache::find( const QString& key, const int& bucket, QPixmap& pixmap )
+{
+    return QPixmapCache::find( bucketKey( key, bucket ), &pixmap );
+}
+
+bool RenderCache::findNearest( const QString& key, const int& bucket, QPixmap& pixmap )
+{
+    if ( find( key, bucket, pixmap ) )
+        return true;
+
+    // a sharper one first, it looks better scaled down
+    for ( int i = 1; i <= m_nearest; i++ )
+        if ( find( key, bucket + i, pixmap ) || find( key, bucket - i, pixmap ) )
+            return true;
+
+    return false;
+}
+
+void RenderCache::insert( const QString& key, const int& bucket, const QPixmap& pixmap )
+{
+    QPixmapCache::insert( bucketKey( key, bucket ), pixmap );
+}
+
+QString RenderCache::bucketKey( const QString& key, const int& bucket )
+{
+    return QString( "qmm:%1:%2" ).arg( key ).arg( bucket );
+}
@@ -0,0 +1,306 @@
+#include "include/spatialgrid.h"
+
+#include <qmath.h>
+
+SpatialGrid::SpatialGrid( const qreal& cellSize ) :
+    m_cellSize( cellSize ),
+    m_stamp( 0 )
+{
+}
+
+void SpatialGrid::clear()
+{
+    m_rects.clear();
+    m_lines.clear();
+    m_margins.clear();
+    m_cells.clear();
+    m_grid.clear();
+    m_seen.clear();
+    m_stamp = 0;
+}
+
+int SpatialGrid::size() const
+{
+    return m_rects.size();
+}
+
+void SpatialGrid::update( const int& id, const QRectF& rect )
+{
+    rectCells( rect, m_newCells );
+    place( id, rect );
+    m_margins[id] = -1;
+}
+
+void SpatialGrid::update( const int& id, const QLineF& line, const qreal& margin )
+{
+    lineCells( line, margin, m_newCells );
+    place( id, QRectF( line.p1(), line.p2() ).normalized().adjusted(
+               -margin, -margin, margin, margin ) );
+    m_lines[id] = line;
+    m_margins[id] = margin;
+}
+
+void SpatialGrid::place( const int& id, const QRectF& rect )
+{
+    if ( id >= m_rects.size() )
+    {
+        m_rects.resize( id + 1 );
+        m_lines.resize( id + 1 );
+        m_margins.resize( id + 1 );
+        m_cells.resize( id + 1 );
+        m_seen.resize( id + 1 );
+    }
+
+    m_rects[id] = rect;
+
+    if ( m_newCells == m_cells.at( id ) )
+        return;
+
+    if ( !m_cells.at( id ).isEmpty() )
+        unlink( id, m_cells.at( id ) );
+
+    link( id, m_newCells );
+    m_cells[id] = m_newCells;
+}
+
+void SpatialGrid::remove( const int& id )
+{
+    if ( id >= m_rects.size() )
+        return;
+
+    if ( !m_cells.at( id ).isEmpty() )
+        unlink( id, m_cells.at( id ) );
+
+    const int last = m_rects.size() - 1;
+
+    if ( id != last )
+    {
+        // rename the last item in its cells
+        foreach ( quint64 k, m_cells.at( last ) )
+        {
+            QVector<int>& cell = m_grid[k];
+            cell[cell.indexOf( last )] = id;
+        }
+
+        m_rects[id] = m_rects.at( last );
+        m_lines[id] = m_lines.at( last );
+        m_margins[id] = m_margins.at( last );
+        m_cells[id] = m_cells.at( last );
+    }
+
+    m_rects.removeLast();
+    m_lines.removeLast();
+    m_margins.removeLast();
+    m_cells.removeLast();
+    m_seen.removeLast();
+}
+
+QRectF SpatialGrid::rect( const int& id ) const
+{
+    return m_rects.at( id );
+}
+
+QRectF SpatialGrid::bounds() const
+{
+    QRectF united;
+
+    for ( int i = 0; i < m_rects.size(); i++ )
+        if ( !m_cells.at( i ).isEmpty() )
+            united = united.united( m_rects.at( i ) );
+
+    return united;
+}
+
+QVector<int> SpatialGrid::query( const QRectF& area ) const
+{
+    QVector<int> result;
+    const QRect range = cells( area );
+
+    if ( ++m_stamp == 0 )
+    {
+        // wrapped around, old stamps could match again
+        m_seen.fill( 0 );
+        m_stamp = 1;
+    }
+
+    const qint64 cellCount = qint64( range.width() ) * range.height();
+
+    if ( cellCount <= m_grid.size() )
+    {
+        for ( int x = range.left(); x <= range.right(); x++ )
+            for ( int y = range.top(); y <= range.bottom(); y++ )
+            {
+                QHash<quint64, QVector<int> >::const_iterator cell =
+                    m_grid.constFind( key( x, y ) );
+
+                if ( cell == m_grid.constEnd() )
+                    continue;
+
+                foreach ( int id, cell.value() )
+                {
+                    if ( m_seen.at( id ) == m_stamp )
+                        continue;
+
+                    m_seen[id] = m_stamp;
+
+                    if ( intersects( id, area ) )
+                        result.append( id );
+                }
+            }
+    }
+    else
+    {
+        // a big area over a sparse grid, cheaper to visit what is there
+        for ( QHash<quint64, QVector<int> >::const_iterator cell = m_grid.constBegin();
+              cell != m_grid.constEnd(); ++cell )
+        {
+            const int x = qint32( cell.key() >> 32 );
+            const int y = qint32( cell.key() & 0xffffffff );
+
+            if ( !range.contains( x, y ) )
+                continue;
+
+            foreach ( int id, cell.value() )
+            {
+                if ( m_seen.at( id ) == m_stamp )
+                    continue;
+
+                m_seen[id] = m_stamp;
+
+                if ( intersects( id, area ) )
+                    result.append( id );
+            }
+        }
+    }
+
+    return result;
+}
+
+QRect SpatialGrid::cells( const QRectF& rect ) const
+{
+    return QRect( QPoint( qFloor( rect.left() / m_cellSize ),
+                          qFloor( rect.top() / m_cellSize ) ),
+                  QPoint( qFloor( rect.right() / m_cellSize ),
+                          qFloor( rect.bottom() / m_cellSize ) ) );
+}
+
+quint64 SpatialGrid::key( const int& x, const int& y )
+{
+    return ( quint64( quint32( x ) ) << 32 ) | quint32( y );
+}
+
+void SpatialGrid::rectCells( const QRectF& rect, QVector<quint64>& keys ) const
+{
+    const QRect range = cells( rect );
+    keys.resize( 0 );
+
+    for ( int x = range.left(); x <= range.right(); x++ )
+        for ( int y = range.top(); y <= range.bottom(); y++ )
+            keys.append( key( x, y ) );
+}
+
+// in each column of cells, the rows the line passes grown by the margin:
+// a walk along the line, cells around its ends are visited once
+void SpatialGrid::lineCells( const QLineF& line, const qreal& margin,
+                             QVector<quint64>& keys ) const
+{
+    const QRect range = cells( QRectF( line.p1(), line.p2() ).normalized().adjusted(
+                                   -margin, -margin, margin, margin ) );
+    const qreal dx = line.dx();
+    const qreal dy = line.dy();
+    keys.resize( 0 );
+
+    for ( int x = range.left(); x <= range.right(); x++ )
+    {
+        qreal from = 0;
+        qreal to = 1;
+
+        // the part of the line over the column and its margin
+        if ( dx != 0 )
+        {
+            from = ( x * m_cellSize - margin - line.x1() ) / dx;
+            to = ( ( x + 1 ) * m_cellSize + margin - line.x1() ) / dx;
+
+            if ( from > to )
+                qSwap( from, to );
+
+            from = qMax( from, qreal( 0 ) );
+            to = qMin( to, qreal( 1 ) );
+        }
+
+        const qreal y1 = line.y1() + from * dy;
+        const qreal y2 = line.y1() + to * dy;
+        const int top = qMax( qFloor( ( qMin( y1, y2 ) - margin ) / m_cellSize ), range.top() );
+        const int bottom = qMin( qFloor( ( qMax( y1, y2 ) + margin ) / m_cellSize ), range.bottom() );
+
+        for ( int y = top; y <= bottom; y++ )
+            keys.append( key( x, y ) );
+    }
+}
+
+// a line item is clipped to the area grown by its margin
+bool SpatialGrid::intersects( const int& id, const QRectF& area ) const
+{
+    if ( !m_rects.at( id ).intersects( area ) )
+        return false;
+
+    const qreal margin = m_margins.at( id );
+
+    if ( margin < 0 )
+        return true;
+
+    const QRectF grown = area.adjusted( -margin, -margin, margin, margin );
+    const QLineF& line = m_lines.at( id );
+    const qreal d[2] = { line.dx(), line.dy() };
+    const qreal p[2] = { line.x1(), line.y1() };
+    const qreal low[2] = { grown.left(), grown.top() };
+    const qreal high[2] = { grown.right(), grown.bottom() };
+    qreal from = 0;
+    qreal to = 1;
+
+    for ( int axis = 0; axis < 2; axis++ )
+    {
+        if ( d[axis] == 0 )
+        {
+            if ( p[axis] < low[axis] || p[axis] > high[axis] )
+                return false;
+
+            continue;
+        }
+
+        qreal enter = ( low[axis] - p[axis] ) / d[axis];
+        qreal leave = ( high[axis] - p[axis] ) / d[axis];
+
+        if ( enter > leave )
+            qSwap( enter, leave );
+
+        from = qMax( from, enter );
+        to = qMin( to, leave );
+
+        if ( from > to )
+            return false;
+    }
+
+    return true;
+}
+
+void SpatialGrid::link( const int& id, const QVector<quint64>& keys )
+{
+    foreach ( quint64 k, keys )
+        m_grid[k].append( id );
+}
+
+void SpatialGrid::unlink( const int& id, const QVector<quint64>& keys )
+{
+    foreach ( quint64 k, keys )
+    {
+        QHash<quint64, QVector<int> >::iterator cell = m_grid.find( k );
+        QVector<int>& ids = cell.value();
+        // order in a cell does not matter
+        ids[ids.indexOf( id )] = ids.last();
+        ids.removeLast();
+
+        if ( ids.isEmpty() )
+            m_grid.erase( cell );
+    }
+}
@@ -0,0 +1,598 @@
+#include "include/treelayout.h"
+
+#include <QPair>
+#include <QtAlgorithms>
+#include <qmath.h>
+
+#include <cmath>
+
+const qreal TreeLayout::m_nodeGap = 12;
+const qreal TreeLayout::m_levelGap = 40;
+
+TreeLayout::TreeLayout( const MindMapModel& model ) :
+    m_model( model ),
+    m_root( -1 ),
+    m_base( 0 )
+{
+}
+
+void TreeLayout::layoutTree( const int& root, const Style& style )
+{
+    m_root = root;
+    m_base = m_model.preorderIndex( root );
+    m_pos.resize( m_model.subtreeSize( root ) );
+
+    for ( int i = 0; i < m_pos.size(); i++ )
+        m_pos[i] = m_model.pos( m_model.subtreeNode( root, i ) );
+
+    QVector<int> children;
+
+    foreach ( const int & edge, m_model.childEdges( root ) )
+        children.append( m_model.destination( edge ) );
+
+    if ( style == Radial )
+    {
+        fan( children, 0, true );
+        return;
+    }
+
+    if ( style != LeftRight || children.isEmpty() )
+        return;
+
+    // clockwise from the top: the first half of the leaves goes right
+    const QPointF rootCenter = center( root );
+    QVector<QPair<qreal, int> > sides;
+    QVector<qreal> leaves;
+    qreal total = 0;
+
+    foreach ( const int & child, children )
+    {
+        const QPointF d = center( child ) - rootCenter;
+        qreal angle = std::atan2( d.y(), d.x() ) + M_PI / 2;
+
+        if ( angle < 0 )
+            angle += 2 * M_PI;
+
+        sides.append( qMakePair( angle, child ) );
+    }
+
+    qSort( sides.begin(), sides.end() );
+
+    for ( int i = 0; i < sides.size(); i++ )
+    {
+        qreal weight = 0;
+        const int child = sides.at( i ).second;
+
+        for ( int j = 0; j < m_model.subtreeSize( child ); j++ )
+        {
+            const int node = m_model.subtreeNode( child, j );
+
+            if ( m_model.childEdges( node ).isEmpty() )
+                weight += scaledSize( node ).height() + m_nodeGap;
+        }
+
+        leaves.append( weight );
+        total += weight;
+    }
+
+    QVector<int> right;
+    QVector<int> left;
+    qreal sum = 0;
+
+    for ( int i = 0; i < sides.size(); i++ )
+    {
+        if ( sum + leaves.at( i ) / 2 <= total / 2 || right.isEmpty() )
+            right.append( sides.at( i ).second );
+        else
+            left.append( sides.at( i ).second );
+
+        sum += leaves.at( i );
+    }
+
+    fan( right, 0, false );
+
+    if ( !left.isEmpty() )
+        fan( left, M_PI, false );
+}
+
+void TreeLayout::layoutSubtree( const int& root, const qreal& direction )
+{
+    m_root = root;
+    m_base = m_model.preorderIndex( root );
+    m_pos.resize( m_model.subtreeSize( root ) );
+
+    for ( int i = 0; i < m_pos.size(); i++ )
+        m_pos[i] = m_model.pos( m_model.subtreeNode( root, i ) );
+
+    QVector<int> children;
+
+    foreach ( const int & edge, m_model.childEdges( root ) )
+        children.append( m_model.destination( edge ) );
+
+    fan( children, direction, false );
+}
+
+int TreeLayout::count() const
+{
+    return m_pos.size();
+}
+
+QPointF TreeLayout::pos( const int& i ) const
+{
+    return m_pos.at( i );
+}
+
+void TreeLayout::fan( const QVector<int>& rootChildren, const qreal& angle,
+                      const bool& circular )
+{
+    if ( rootChildren.isEmpty() )
+        return;
+
+    prepare( rootChildren, angle, circular );
+    firstWalk();
+    secondWalk();
+    circular ? placeAround() : placeAlong( angle );
+}
+
+void TreeLayout::prepare( const QVector<int>& rootChildren, const qreal& angle,
+                          const bool& circular )
+{
+    const int count = m_pos.size();
+    m_included.fill( false, count );
+    m_parent.fill( -1, count );
+    m_level.fill( 0, count );
+    m_childStart.fill( 0, count );
+    m_childCount.fill( 0, count );
+    m_breadth.fill( 0, count );
+    m_depth.fill( 0, count );
+    m_prelim.fill( 0, count );
+    m_mod.fill( 0, count );
+    m_change.fill( 0, count );
+    m_shift.fill( 0, count );
+    m_midpoint.fill( 0, count );
+    m_thread.fill( -1, count );
+    m_ancestor.resize( count );
+    m_number.fill( 0, count );
+    m_across.fill( 0, count );
+    m_children.clear();
+
+    m_included[0] = true;
+
+    foreach ( const int & child, rootChildren )
+        m_included[local( child )] = true;
+
+    // the pre-order has parents first: inclusion, levels and child counts
+    for ( int i = 1; i < count; i++ )
+    {
+        const int parent = local( m_model.parentNode( m_model.subtreeNode( m_root, i ) ) );
+        m_parent[i] = parent;
+
+        if ( parent != 0 )
+            m_included[i] = m_included.at( parent );
+
+        if ( !m_included.at( i ) )
+            continue;
+
+        m_level[i] = m_level.at( parent ) + 1;
+        m_childCount[parent]++;
+    }
+
+    const qreal ux = qAbs( std::cos( angle ) );
+    const qreal uy = qAbs( std::sin( angle ) );
+    int start = 0;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        m_ancestor[i] = i;
+        m_childStart[i] = start;
+        start += m_childCount.at( i );
+
+        if ( !m_included.at( i ) )
+            continue;
+
+        // across the layers a circular layer is turned any way
+        const QSizeF size = scaledSize( m_model.subtreeNode( m_root, i ) );
+
+        if ( circular )
+        {
+            m_breadth[i] = m_depth[i] = std::sqrt( size.width() * size.width() +
+                                                   size.height() * size.height() );
+        }
+        else
+        {
+            m_depth[i] = size.width() * ux + size.height() * uy;
+            m_breadth[i] = size.width() * uy + size.height() * ux;
+        }
+    }
+
+    // children in the order they have on the map now
+    m_children.fill( -1, start );
+    QVector<int> filled( count, 0 );
+    const QPointF across( -std::sin( angle ), std::cos( angle ) );
+    const QPointF rootCenter = center( m_root );
+    QVector<qreal> key( count, 0 );
+
+    for ( int i = 1; i < count; i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        const int parent = m_parent.at( i );
+        const QPointF c = center( m_model.subtreeNode( m_root, i ) );
+
+        if ( !circular )
+        {
+            key[i] = c.x() * across.x() + c.y() * across.y();
+        }
+        else if ( parent == 0 )
+        {
+            key[i] = std::atan2( c.y() - rootCenter.y(), c.x() - rootCenter.x() );
+        }
+        else
+        {
+            // turning away from the direction of the parent
+            const QPointF p = center( m_model.subtreeNode( m_root, parent ) );
+            qreal turn = std::atan2( c.y() - p.y(), c.x() - p.x() ) -
+                         std::atan2( p.y() - rootCenter.y(), p.x() - rootCenter.x() );
+
+            while ( turn > M_PI )
+                turn -= 2 * M_PI;
+
+            while ( turn <= -M_PI )
+                turn += 2 * M_PI;
+
+            key[i] = turn;
+        }
+
+        m_children[m_childStart.at( parent ) + filled.at( parent )] = i;
+        filled[parent]++;
+    }
+
+    QVector<QPair<qreal, int> > sorted;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( m_childCount.at( i ) < 2 )
+            continue;
+
+        sorted.clear();
+
+        for ( int j = 0; j < m_childCount.at( i ); j++ )
+        {
+            const int child = m_children.at( m_childStart.at( i ) + j );
+            sorted.append( qMakePair( key.at( child ), child ) );
+        }
+
+        qSort( sorted.begin(), sorted.end() );
+
+        for ( int j = 0; j < sorted.size(); j++ )
+        {
+            m_children[m_childStart.at( i ) + j] = sorted.at( j ).second;
+            m_number[sorted.at( j ).second] = j;
+        }
+    }
+}
+
+// post-order: the pre-order backwards. Placing the children of a node
+// with its left siblings is done by the parent, all of them at once
+void TreeLayout::firstWalk()
+{
+    for ( int v = m_pos.size() - 1; v >= 0; v-- )
+    {
+        if ( !m_included.at( v ) || m_childCount.at( v ) == 0 )
+            continue;
+
+        const int first = m_childStart.at( v );
+        const int last = first + m_childCount.at( v ) - 1;
+        int defaultAncestor = m_children.at( first );
+
+        for ( int k = first; k <= last; k++ )
+        {
+            const int w = m_children.at( k );
+            const int left = k == first ? -1 : m_children.at( k - 1 );
+
+            if ( m_childCount.at( w ) == 0 )
+            {
+                m_prelim[w] = left == -1 ? 0 : m_prelim.at( left ) + separation( left, w );
+            }
+            else if ( left == -1 )
+            {
+                m_prelim[w] = m_midpoint.at( w );
+            }
+            else
+            {
+                m_prelim[w] = m_prelim.at( left ) + separation( left, w );
+                m_mod[w] = m_prelim.at( w ) - m_midpoint.at( w );
+            }
+
+            defaultAncestor = apportion( w, defaultAncestor );
+        }
+
+        executeShifts( v );
+        m_midpoint[v] = ( m_prelim.at( m_children.at( first ) ) +
+                          m_prelim.at( m_children.at( last ) ) ) / 2;
+    }
+
+    m_prelim[0] = m_midpoint.at( 0 );
+}
+
+void TreeLayout::secondWalk()
+{
+    // sum of the modifiers of the ancestors
+    QVector<qreal> sum( m_pos.size(), 0 );
+    m_across[0] = m_prelim.at( 0 );
+
+    for ( int i = 1; i < m_pos.size(); i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        const int parent = m_parent.at( i );
+        sum[i] = sum.at( parent ) + m_mod.at( parent );
+        m_across[i] = m_prelim.at( i ) + sum.at( i );
+    }
+}
+
+int TreeLayout::apportion( const int& v, int defaultAncestor )
+{
+    if ( m_number.at( v ) == 0 )
+        return defaultAncestor;
+
+    const int first = m_childStart.at( m_parent.at( v ) );
+    // inside and outside contours of the right (v) and the left subtrees
+    int vir = v;
+    int vor = v;
+    int vil = m_children.at( first + m_number.at( v ) - 1 );
+    int vol = m_children.at( first );
+    qreal sir = m_mod.at( vir );
+    qreal sor = m_mod.at( vor );
+    qreal sil = m_mod.at( vil );
+    qreal sol = m_mod.at( vol );
+
+    while ( nextRight( vil ) != -1 && nextLeft( vir ) != -1 )
+    {
+        vil = nextRight( vil );
+        vir = nextLeft( vir );
+        vol = nextLeft( vol );
+        vor = nextRight( vor );
+        m_ancestor[vor] = v;
+        const qreal shift = ( m_prelim.at( vil ) + sil ) - ( m_prelim.at( vir ) + sir ) +
+                            separation( vil, vir );
+
+        if ( shift > 0 )
+        {
+            moveSubtree( ancestor( vil, v, defaultAncestor ), v, shift );
+            sir += shift;
+            sor += shift;
+        }
+
+        sil += m_mod.at( vil );
+        sir += m_mod.at( vir );
+        sol += m_mod.at( vol );
+        sor += m_mod.at( vor );
+    }
+
+    if ( nextRight( vil ) != -1 && nextRight( vor ) == -1 )
+    {
+        m_thread[vor] = nextRight( vil );
+        m_mod[vor] += sil - sor;
+    }
+
+    if ( nextLeft( vir ) != -1 && nextLeft( vol ) == -1 )
+    {
+        m_thread[vol] = nextLeft( vir );
+        m_mod[vol] += sir - sol;
+        defaultAncestor = v;
+    }
+
+    return defaultAncestor;
+}
+
+void TreeLayout::moveSubtree( const int& left, const int& right, const qreal& shift )
+{
+    const qreal subtrees = m_number.at( right ) - m_number.at( left );
+    m_change[right] -= shift / subtrees;
+    m_shift[right] += shift;
+    m_change[left] += shift / subtrees;
+    m_prelim[right] += shift;
+    m_mod[right] += shift;
+}
+
+void TreeLayout::executeShifts( const int& v )
+{
+    qreal shift = 0;
+    qreal change = 0;
+
+    for ( int k = m_childStart.at( v ) + m_childCount.at( v ) - 1;
+          k >= m_childStart.at( v ); k-- )
+    {
+        const int w = m_children.at( k );
+        m_prelim[w] += shift;
+        m_mod[w] += shift;
+        change += m_change.at( w );
+        shift += m_shift.at( w ) + change;
+    }
+}
+
+int TreeLayout::nextLeft( const int& v ) const
+{
+    return m_childCount.at( v ) ?
+           m_children.at( m_childStart.at( v ) ) :
+           m_thread.at( v );
+}
+
+int TreeLayout::nextRight( const int& v ) const
+{
+    return m_childCount.at( v ) ?
+           m_children.at( m_childStart.at( v ) + m_childCount.at( v ) - 1 ) :
+           m_thread.at( v );
+}
+
+int TreeLayout::ancestor( const int& vil, const int& v, const int& defaultAncestor ) const
+{
+    const int candidate = m_ancestor.at( vil );
+    return m_parent.at( candidate ) == m_parent.at( v ) ? candidate : defaultAncestor;
+}
+
+qreal TreeLayout::separation( const int& left, const int& right ) const
+{
+    return ( m_breadth.at( left ) + m_breadth.at( right ) ) / 2 + m_nodeGap;
+}
+
+// layers one after the other along the direction
+void TreeLayout::placeAlong( const qreal& angle )
+{
+    QVector<qreal> extent;
+
+    for ( int i = 0; i < m_pos.size(); i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        if ( m_level.at( i ) >= extent.size() )
+            extent.resize( m_level.at( i ) + 1 );
+
+        extent[m_level.at( i )] = qMax( extent.at( m_level.at( i ) ), m_depth.at( i ) );
+    }
+
+    QVector<qreal> layer( extent.size(), 0 );
+
+    for ( int d = 1; d < extent.size(); d++ )
+        layer[d] = layer.at( d - 1 ) + ( extent.at( d - 1 ) + extent.at( d ) ) / 2 + m_levelGap;
+
+    const QPointF along( std::cos( angle ), std::sin( angle ) );
+    const QPointF across( -along.y(), along.x() );
+    const QPointF rootCenter = center( m_root );
+
+    for ( int i = 1; i < m_pos.size(); i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        const QSizeF size = scaledSize( m_model.subtreeNode( m_root, i ) );
+        m_pos[i] = rootCenter + along * layer.at( m_level.at( i ) ) +
+                   across * ( m_across.at( i ) - m_across.at( 0 ) ) -
+                   QPointF( size.width() / 2, size.height() / 2 );
+    }
+}
+
+// the position across the layers is turned to an angle, the layers to
+// circles far enough for neighbours not to overlap
+void TreeLayout::placeAround()
+{
+    qreal low = 0;
+    qreal high = 0;
+    QVector<qreal> extent( 1, m_depth.at( 0 ) );
+
+    for ( int i = 1; i < m_pos.size(); i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        if ( extent.size() == 1 )
+        {
+            low = m_across.at( i ) - m_breadth.at( i ) / 2;
+            high = m_across.at( i ) + m_breadth.at( i ) / 2;
+        }
+
+        low = qMin( low, m_across.at( i ) - m_breadth.at( i ) / 2 );
+        high = qMax( high, m_across.at( i ) + m_breadth.at( i ) / 2 );
+
+        if ( m_level.at( i ) >= extent.size() )
+            extent.resize( m_level.at( i ) + 1 );
+
+        extent[m_level.at( i )] = qMax( extent.at( m_level.at( i ) ), m_depth.at( i ) );
+    }
+
+    const qreal circle = high - low + m_nodeGap;
+
+    // radius needed by the neighbours of each layer: the depth first order
+    // of the sorted children visits a layer from left to right
+    QVector<qreal> needed( extent.size(), 0 );
+    QVector<int> firstOf( extent.size(), -1 );
+    QVector<int> lastOf( extent.size(), -1 );
+    QVector<int> stack( 1, 0 );
+
+    while ( !stack.isEmpty() )
+    {
+        const int v = stack.last();
+        stack.pop_back();
+
+        for ( int k = m_childStart.at( v ) + m_childCount.at( v ) - 1;
+              k >= m_childStart.at( v ); k-- )
+            stack.append( m_children.at( k ) );
+
+        if ( v == 0 )
+            continue;
+
+        const int level = m_level.at( v );
+
+        if ( lastOf.at( level ) == -1 )
+            firstOf[level] = v;
+        else
+            needed[level] = qMax( needed.at( level ), chordRadius(
+                                      lastOf.at( level ), v,
+                                      2 * M_PI * ( m_across.at( v ) - m_across.at( lastOf.at( level ) ) ) / circle ) );
+
+        lastOf[level] = v;
+    }
+
+    // the last and the first of a layer are neighbours too
+    for ( int d = 1; d < extent.size(); d++ )
+    {
+        if ( firstOf.at( d ) != lastOf.at( d ) )
+            needed[d] = qMax( needed.at( d ), chordRadius(
+                                  lastOf.at( d ), firstOf.at( d ),
+                                  2 * M_PI * ( 1 - ( m_across.at( lastOf.at( d ) ) -
+                                                     m_across.at( firstOf.at( d ) ) ) / circle ) ) );
+    }
+
+    QVector<qreal> radius( extent.size(), 0 );
+
+    for ( int d = 1; d < extent.size(); d++ )
+        radius[d] = qMax( radius.at( d - 1 ) + ( extent.at( d - 1 ) + extent.at( d ) ) / 2 +
+                          m_levelGap, needed.at( d ) );
+
+    // turned to keep the first child in its direction
+    const int first = firstOf.at( 1 );
+    const QPointF rootCenter = center( m_root );
+    const QPointF firstCenter = center( m_model.subtreeNode( m_root, first ) ) - rootCenter;
+    const qreal start = std::atan2( firstCenter.y(), firstCenter.x() );
+
+    for ( int i = 1; i < m_pos.size(); i++ )
+    {
+        if ( !m_included.at( i ) )
+            continue;
+
+        const QSizeF size = scaledSize( m_model.subtreeNode( m_root, i ) );
+        const qreal angle = start + 2 * M_PI * ( m_across.at( i ) - m_across.at( first ) ) / circle;
+        m_pos[i] = rootCenter +
+                   QPointF( std::cos( angle ), std::sin( angle ) ) * radius.at( m_level.at( i ) ) -
+                   QPointF( size.width() / 2, size.height() / 2 );
+    }
+}
+
+// distance of two nodes angle apart from the center for the separation
+qreal TreeLayout::chordRadius( const int& left, const int& right, const qreal& angle ) const
+{
+    return angle < M_PI ?
+           separation( left, right ) / ( 2 * std::sin( angle / 2 ) ) :
+           separation( left, right ) / 2;
+}
+
+QPointF TreeLayout::center( const int& node ) const
+{
+    const QSizeF size = scaledSize( node );
+    return m_model.pos( node ) + QPointF( size.width() / 2, size.height() / 2 );
+}
+
+QSizeF TreeLayout::scaledSize( const int& node ) const
+{
+    const QSizeF size = m_model.size( node );
+    return size.isValid() ? size * m_model.scale( node ) : QSizeF( 0, 0 );
+}
+
+int TreeLayout::local( const int& node ) const
+{
+    return m_model.preorderIndex( node ) - m_base;
+}